@@ -22,15 +22,55 @@
 #include "Arduino.h"
 #include "DFRobot_ESP_EC_PH.h"
 #include "EEPROM.h"
+#include <stdio.h>
 
-#define RES2 820.0
-#define ECREF 200.0
+//----- Calibration state machine -----
+//one state and one table lookup per command, the actions below only touch data
+
+#define CAL_IDLE 0  //no session, calmode 0
+#define CAL_EC 1    //EC calibration session, calmode 1
+#define CAL_PH 2    //pH calibration session, calmode 2
+#define CAL_PUMP 3  //nutrient pump setup, calmode 4
+#define CAL_STATE_COUNT 4
+
+#define CAL_COMMAND_COUNT 13 //command codes of cmdParse(), 9..12 are internal
+
+#define ACT_NONE 0
+#define ACT_COMMAND_ERROR 1
+#define ACT_MULTIPLE_CALIBRATION 2
+#define ACT_MULTIPLE_COMMAND 3
+#define ACT_WRONG_CAL 4
+#define ACT_WRONG_EXIT 5
+#define ACT_ENTER_EC 6
+#define ACT_CAL_EC 7
+#define ACT_EXIT_EC 8
+#define ACT_ENTER_PH 9
+#define ACT_CAL_PH 10
+#define ACT_EXIT_PH 11
+#define ACT_DOSE_DOWN 12
+#define ACT_DOSE_UP 13
+#define ACT_PUMP_ON 14
+#define ACT_PUMP_OFF 15
+#define ACT_PUMP_EXIT 16
+
+#define CAL_POINT_EC_LOW 0x01    //1.413ms/cm buffer calibrated
+#define CAL_POINT_EC_HIGH 0x02   //2.76ms/cm or 12.88ms/cm buffer calibrated
+#define CAL_POINT_PH_NEUTRAL 0x04 //pH 7.0 buffer calibrated
+#define CAL_POINT_PH_ACID 0x08    //pH 4.0 buffer calibrated
+
+//parts of the calibration image stageCalibration() copies to the EEPROM cache
+#define STAGE_EC 0x01 //kvalueLow, kvalueHigh
+#define STAGE_PH 0x02 //neutralVoltage, acidVoltage, phCalTemperature
+#define STAGE_ALL (STAGE_EC | STAGE_PH)
+
+#ifndef ECPH_MESSAGE_CODES
+static const char *const messageText[ECPH_MESSAGE_COUNT] = { //kept in flash, see DFRobot_ESP_EC_PH_Messages.h
+#define ECPH_MESSAGE_TEXT(id, text) text,
+    ECPH_MESSAGE_LIST(ECPH_MESSAGE_TEXT)
+#undef ECPH_MESSAGE_TEXT
+};
+#endif
 
-int cal1 = 0; //detection flag for 1.413us/cm buffer solution -> detected (1), uncalibrated (0)
-int cal2 = 0; //detection flag for 12.88us/cm buffer solution -> detected (1), uncalibrated (0)
-int cal3 = 0; //detection flag for PH 7.00 buffer solution -> detected (1), uncalibrated (0)
-int cal4 = 0; //detection flag for PH 4.00 buffer solution -> detected (1), uncalibrated (0)
-int calmode = 0; //flag for PH (2), EC (1) and non-calibration mode (0)
 DFRobot_ESP_EC_PH::DFRobot_ESP_EC_PH()
 {
 //----- EC Variables Declaration -----
@@ -38,7 +78,7 @@ DFRobot_ESP_EC_PH::DFRobot_ESP_EC_PH()
     this->_kvalue = 1.0;
     this->_kvalueLow = 1.0;
     this->_kvalueHigh = 1.0;
-    this->_cmdReceivedBufferIndex = 0;
+    this->_ecRangeHigh = false;
     this->_ecvoltage = 0.0;
     this->_eccalibrated = false;
 
@@ -47,6 +87,8 @@ DFRobot_ESP_EC_PH::DFRobot_ESP_EC_PH()
     this->_acidVoltage = PH_4_AT_25;    //buffer solution 4.0 at 25C
     this->_neutralVoltage = PH_7_AT_25; //buffer solution 7.0 at 25C
     this->_phvoltage = PH_7_AT_25;
+    this->_phCalTemperature = PH_CAL_TEMPERATURE_DEFAULT;
+    updatePHModel();
     this->_phcalibrated = false; // Initialize the calibration status as false 
 
 //----- Others -----  
@@ -58,106 +100,376 @@ DFRobot_ESP_EC_PH::DFRobot_ESP_EC_PH()
     
     customBlink = false;
     ncustomBlink = false;
+
+    this->_eepromDirty = false;
+    this->_batchActive = false;
+    this->_stagedTime = 0;
+    this->_commitDelay = ECPH_COMMIT_DELAY;
+#ifdef ESP32
+    this->_eepromLock = NULL;
+    this->_commitTask = NULL;
+#endif
+    this->_cmdFailed = false;
+    this->_calState = CAL_IDLE;
+    this->_calPoints = 0;
+    this->_calPointDone = false;
+    this->_calibrationDefaults = 0;
+    this->_beginMicros = 0;
+
+    this->_clock = millis;
+
+//----- Command Ports -----
+    this->_portCount = 0;
+    this->_nextPort = 0;
+    this->_activePort = NULL;
+    this->_cmdStream = &Serial;
+    addCommandPort(Serial);
+
+//----- Sampling Governor -----
+    memset(&this->_ecTrack, 0, sizeof(this->_ecTrack));
+    memset(&this->_phTrack, 0, sizeof(this->_phTrack));
+    this->_sampleIntervalMin = SAMPLE_INTERVAL_MIN;
+    this->_sampleIntervalMax = SAMPLE_INTERVAL_MAX;
+    this->_sampleInterval = SAMPLE_INTERVAL_MIN;
+    this->_lastSampleTime = 0;
 }
 
 DFRobot_ESP_EC_PH::~DFRobot_ESP_EC_PH()
 {
+#ifdef ESP32
+    if (this->_commitTask != NULL)
+    {
+        lockEEPROM(true); //not in the middle of a commit
+        vTaskDelete(this->_commitTask);
+        this->_commitTask = NULL;
+        unlockEEPROM();
+    }
+    if (this->_eepromLock != NULL)
+    {
+        vSemaphoreDelete(this->_eepromLock);
+        this->_eepromLock = NULL;
+    }
+#endif
 }
 
-void DFRobot_ESP_EC_PH::begin(int ECEepromStartAddress, int PHEepromStartAddress)
+//older releases wrote the defaults into the EEPROM on first boot, a real calibration
+//never lands exactly on them, so they still count as defaults
+static bool calibrationValueValid(float value, float legacyDefault)
 {
-//------ EC Sensor Initialization ------
+    return !(value == float() || isnan(value) || isinf(value) //blank (0 or 0xFF) or corrupt EEPROM
+             || value == legacyDefault);
+}
+
+//a NaN or a disconnected sensor (-127C) would skew the pH slope
+static bool calibrationTemperatureValid(float temperature)
+{
+    return temperature > PH_CAL_TEMPERATURE_MIN && temperature <= PH_CAL_TEMPERATURE_MAX; //false for NaN
+}
+
+void DFRobot_ESP_EC_PH::begin(int ECEepromStartAddress, int PHEepromStartAddress, int PHTempEepromAddress)
+{
+    unsigned long beginStart = micros();
+#ifdef ESP32
+    if (this->_eepromLock == NULL)
+    {
+        this->_eepromLock = xSemaphoreCreateMutex();
+    }
+#endif
+    float image[5]; //kvalueLow, kvalueHigh, neutralVoltage, acidVoltage, phCalTemperature
     this->_eceepromStartAddress = ECEepromStartAddress;
     this->_pheepromStartAddress = PHEepromStartAddress;
-    //check if calibration values (kvalueLow and kvalueHigh) are stored in eeprom
-    this->_kvalueLow = EEPROM.readFloat(this->_eceepromStartAddress); //read the calibrated K value from EEPROM
-    if (this->_kvalueLow == float() || isnan(this->_kvalueLow))
+    this->_phTempEepromAddress = (PHTempEepromAddress >= 0) ? PHTempEepromAddress : ECEepromStartAddress + 2 * (int)sizeof(float);
+    this->_calibrationDefaults = 0;
+
+    //load the whole calibration image in one pass
+    EEPROM.readBytes(this->_eceepromStartAddress, &image[0], 2 * sizeof(float));
+    EEPROM.readBytes(this->_pheepromStartAddress, &image[2], 2 * sizeof(float));
+    EEPROM.readBytes(this->_phTempEepromAddress, &image[4], sizeof(float));
+
+//------ EC Sensor Initialization ------
+    this->_kvalueLow = image[0];
+    if (!calibrationValueValid(this->_kvalueLow, 1.0f))
     {
-        this->_kvalueLow = 1.0; // For new EEPROM, write default value( K = 1.0) to EEPROM
-        EEPROM.writeFloat(this->_eceepromStartAddress, this->_kvalueLow);
-        EEPROM.commit();
+        this->_kvalueLow = 1.0; // For new EEPROM, use default value( K = 1.0)
+        this->_calibrationDefaults |= ECPH_DEFAULT_KVALUE_LOW;
     }
-
-    this->_kvalueHigh = EEPROM.readFloat(this->_eceepromStartAddress + (int)sizeof(float)); //read the calibrated K value from EEPROM
-    if (this->_kvalueHigh == float() || isnan(this->_kvalueHigh))
+    this->_kvalueHigh = image[1];
+    if (!calibrationValueValid(this->_kvalueHigh, 1.0f))
     {
-        this->_kvalueHigh = 1.0; // For new EEPROM, write default value( K = 1.0) to EEPROM
-        EEPROM.writeFloat(this->_eceepromStartAddress + (int)sizeof(float), this->_kvalueHigh);
-        EEPROM.commit();
+        this->_kvalueHigh = 1.0; // For new EEPROM, use default value( K = 1.0)
+        this->_calibrationDefaults |= ECPH_DEFAULT_KVALUE_HIGH;
     }
     this->_kvalue = this->_kvalueLow; // set default K value: K = kvalueLow
+    this->_ecRangeHigh = false;
 
 //------- PH Sensor Initialization ------
-    //check if calibration values (neutral and acid) are stored in eeprom
-    this->_neutralVoltage = EEPROM.readFloat(this->_pheepromStartAddress); //load the neutral (pH = 7.0) voltage of the pH board from the EEPROM
-    if (this->_neutralVoltage == float() || isnan(this->_neutralVoltage) || isinf(this->_neutralVoltage))
+    this->_neutralVoltage = image[2];
+    if (!calibrationValueValid(this->_neutralVoltage, PH_7_AT_25))
+    {
+        this->_neutralVoltage = PH_7_AT_25; // new EEPROM, use typical voltage
+        this->_calibrationDefaults |= ECPH_DEFAULT_NEUTRAL_VOLTAGE;
+    }
+    this->_acidVoltage = image[3];
+    if (!calibrationValueValid(this->_acidVoltage, PH_4_AT_25))
+    {
+        this->_acidVoltage = PH_4_AT_25; // new EEPROM, use typical voltage
+        this->_calibrationDefaults |= ECPH_DEFAULT_ACID_VOLTAGE;
+    }
+    this->_phCalTemperature = image[4];
+    if (!calibrationTemperatureValid(this->_phCalTemperature))
     {
-        this->_neutralVoltage = PH_7_AT_25; // new EEPROM, write typical voltage
-        EEPROM.writeFloat(this->_pheepromStartAddress, this->_neutralVoltage);
-        EEPROM.commit();
+        this->_phCalTemperature = PH_CAL_TEMPERATURE_DEFAULT; // new EEPROM, assume the 25C buffers
+        this->_calibrationDefaults |= ECPH_DEFAULT_PH_CAL_TEMPERATURE;
     }
+    updatePHModel();
+
+    //defaults are not written back, a value left blank in the EEPROM keeps reading as uncalibrated
+
+    this->_lastSampleTime = this->_clock() - this->_sampleInterval; //first sample due right away
+#ifdef ESP32
+    beginCommitTask(); //calibration commits stay off the control loop, elsewhere the sketch calls idle()
+#endif
+    this->_beginMicros = micros() - beginStart;
+}
 
-    this->_acidVoltage = EEPROM.readFloat(this->_pheepromStartAddress + (int)sizeof(float)); //load the acid (pH = 4.0) voltage of the pH board from the EEPROM
-    if (this->_acidVoltage == float() || isnan(this->_acidVoltage) || isinf(this->_acidVoltage))
+bool DFRobot_ESP_EC_PH::lockEEPROM(bool wait)
+{
+#ifdef ESP32
+    if (this->_eepromLock != NULL)
     {
-        this->_acidVoltage = PH_4_AT_25; // new EEPROM, write typical voltage
-        EEPROM.writeFloat(this->_pheepromStartAddress + (int)sizeof(float), this->_acidVoltage);
-        EEPROM.commit();
+        return xSemaphoreTake(this->_eepromLock, wait ? portMAX_DELAY : 0) == pdTRUE;
     }
+#else
+    (void)wait;
+#endif
+    return true;
+}
 
+void DFRobot_ESP_EC_PH::unlockEEPROM()
+{
+#ifdef ESP32
+    if (this->_eepromLock != NULL)
+    {
+        xSemaphoreGive(this->_eepromLock);
+    }
+#endif
 }
 
-float DFRobot_ESP_EC_PH::readEC(float voltage, float temperature)
+void DFRobot_ESP_EC_PH::stageCalibration(byte parts)
 {
-    float value = 0, valueTemp = 0;
-    this->_rawEC = 1000 * voltage / RES2 / ECREF;
-    //Serial.print(F(">>>rawEC: "));
-    //Serial.println(this->_rawEC, 4);
-    valueTemp = this->_rawEC * this->_kvalue;
-    //automatic shift process
-    //First Range:(0,2); Second Range:(2,20)
-    if (valueTemp > 2.5)
+    lockEEPROM(true); //waits while the commit task is writing the flash, see the header
+    //values still at their default are saved blank, so begin() defaults them again
+    byte defaults = this->_calibrationDefaults;
+    if (parts & STAGE_EC)
+    {
+        EEPROM.writeFloat(this->_eceepromStartAddress, (defaults & ECPH_DEFAULT_KVALUE_LOW) ? float() : this->_kvalueLow);
+        EEPROM.writeFloat(this->_eceepromStartAddress + (int)sizeof(float), (defaults & ECPH_DEFAULT_KVALUE_HIGH) ? float() : this->_kvalueHigh);
+    }
+    if (parts & STAGE_PH)
+    {
+        EEPROM.writeFloat(this->_pheepromStartAddress, (defaults & ECPH_DEFAULT_NEUTRAL_VOLTAGE) ? float() : this->_neutralVoltage);
+        EEPROM.writeFloat(this->_pheepromStartAddress + (int)sizeof(float), (defaults & ECPH_DEFAULT_ACID_VOLTAGE) ? float() : this->_acidVoltage);
+        EEPROM.writeFloat(this->_phTempEepromAddress, (defaults & ECPH_DEFAULT_PH_CAL_TEMPERATURE) ? float() : this->_phCalTemperature);
+    }
+    this->_eepromDirty = true;
+    this->_stagedTime = this->_clock(); //coalesce with further changes
+    unlockEEPROM();
+}
+
+bool DFRobot_ESP_EC_PH::flush()
+{
+    if (!this->_eepromDirty)
+    {
+        return true;
+    }
+    lockEEPROM(true);
+    bool committed = true;
+    if (this->_eepromDirty)
+    {
+        this->_eepromDirty = false;
+        committed = EEPROM.commit();
+        if (!committed)
+        {
+            this->_eepromDirty = true; //idle() retries after the commit delay
+            this->_stagedTime = this->_clock();
+        }
+    }
+    unlockEEPROM();
+    return committed;
+}
+
+void DFRobot_ESP_EC_PH::idle()
+{
+    if (!this->_eepromDirty || this->_batchActive)
+    {
+        return; //runBatch() commits its own script
+    }
+    if ((uint32_t)(this->_clock() - this->_stagedTime) < (uint32_t)this->_commitDelay)
     {
-        this->_kvalue = this->_kvalueHigh;
+        return;
     }
-    else if (valueTemp < 2.0)
+    if (!lockEEPROM(false))
     {
-        this->_kvalue = this->_kvalueLow;
+        return; //the other side holds the cache, try again next time
     }
+    if (this->_eepromDirty && !this->_batchActive)
+    {
+        this->_eepromDirty = false;
+        if (!EEPROM.commit())
+        {
+            this->_eepromDirty = true;
+            this->_stagedTime = this->_clock();
+        }
+    }
+    unlockEEPROM();
+}
+
+#ifdef ESP32
+static void commitTaskLoop(void *meter)
+{
+    for (;;)
+    {
+        ((DFRobot_ESP_EC_PH *)meter)->idle();
+        vTaskDelay(pdMS_TO_TICKS(ECPH_COMMIT_TASK_PERIOD));
+    }
+}
+#endif
+
+bool DFRobot_ESP_EC_PH::beginCommitTask()
+{
+#ifdef ESP32
+    if (this->_commitTask != NULL)
+    {
+        return true;
+    }
+    if (this->_eepromLock == NULL)
+    {
+        return false; //call begin() first
+    }
+    return xTaskCreate(commitTaskLoop, "ecphCommit", ECPH_COMMIT_TASK_STACK, this, ECPH_COMMIT_TASK_PRIORITY, &this->_commitTask) == pdPASS;
+#else
+    return false; //no background task here, call idle() from the loop
+#endif
+}
+
+bool DFRobot_ESP_EC_PH::isCommitPending()
+{
+    return this->_eepromDirty;
+}
+
+void DFRobot_ESP_EC_PH::setCommitDelay(unsigned long delay)
+{
+    this->_commitDelay = delay;
+}
+
+unsigned long DFRobot_ESP_EC_PH::getBeginMicros()
+{
+    return this->_beginMicros;
+}
+
+byte DFRobot_ESP_EC_PH::getCalibrationDefaults()
+{
+    return this->_calibrationDefaults;
+}
+
+//a probe counts as calibrated when both of its points came from the EEPROM, the session
+//flags alone would forget every calibration at the next reboot
+boolean DFRobot_ESP_EC_PH::ecCalibrated()
+{
+    return this->_eccalibrated || !(this->_calibrationDefaults & (ECPH_DEFAULT_KVALUE_LOW | ECPH_DEFAULT_KVALUE_HIGH));
+}
+
+boolean DFRobot_ESP_EC_PH::phCalibrated()
+{
+    return this->_phcalibrated || !(this->_calibrationDefaults & (ECPH_DEFAULT_NEUTRAL_VOLTAGE | ECPH_DEFAULT_ACID_VOLTAGE));
+}
 
-    value = this->_rawEC * this->_kvalue;                  //calculate the EC value after automatic shift
-    value = value / (1.0 + 0.0185 * (temperature - 25.0)); //temperature compensation
-    this->_ecvalue = value;                                //store the EC value for Serial CMD calibration
+float DFRobot_ESP_EC_PH::readEC(float voltage, float temperature)
+{
+    this->_rawEC = ecphRawEC(voltage);
+    //Serial.print(F(">>>rawEC: "));
+    //Serial.println(this->_rawEC, 4);
+    this->_ecRangeHigh = ecphRangeHigh(this->_rawEC, this->_ecRangeHigh, this->_kvalueLow, this->_kvalueHigh); //automatic shift process
+    this->_kvalue = this->_ecRangeHigh ? this->_kvalueHigh : this->_kvalueLow;
+    this->_ecvalue = ecphEC(this->_rawEC, this->_kvalue, temperature); //store the EC value for Serial CMD calibration
     //Serial.print(F(", ecValue: "));
     //Serial.print(this->_ecvalue, 4);
     //Serial.println(F("<<<"));
+    trackSample(this->_ecTrack, this->_ecvalue, EC_STABLE_RATE, EC_STABLE_STDDEV, EC_ABRUPT_STEP);
     return this->_ecvalue;
 }
 
 float DFRobot_ESP_EC_PH::readPH(float voltage, float temperature)
 {
-    // Serial.print("[readPH]... _neutraVoltage:");
-    // Serial.print(this->_neutralVoltage);
-    // Serial.print(", _acidVoltage:");
-    // Serial.print(this->_acidVoltage);
-    float slope = (7.0 - 4.0) / ((this->_neutralVoltage - PH_7_AT_25) / 3.0 - (this->_acidVoltage - PH_7_AT_25) / 3.0); // two point: (_neutralVoltage,7.0),(_acidVoltage,4.0)
-    float intercept = 7.0 - slope * (this->_neutralVoltage - PH_7_AT_25) / 3.0;
-    // Serial.print(", slope:");
-    // Serial.print(slope);
-    // Serial.print(", intercept:");
-    // Serial.println(intercept);
-    this->_phValue = slope * (voltage - PH_7_AT_25) / 3.0 + intercept; //y = k*x + b
-    //Serial.print(F(">>>phValue "));
-    //Serial.print(this->_phValue, 4);
-    //Serial.println(F("<<<"));
+    this->_phValue = ecphPH(voltage, temperature, this->_phSlope, this->_neutralVoltage);
+    trackSample(this->_phTrack, this->_phValue, PH_STABLE_RATE, PH_STABLE_STDDEV, PH_ABRUPT_STEP);
     return this->_phValue;
 }
 
+void DFRobot_ESP_EC_PH::updatePHModel()
+{
+    this->_phSlope = ecphPHSlope(this->_neutralVoltage, this->_acidVoltage, this->_phCalTemperature);
+}
+
+float DFRobot_ESP_EC_PH::getPHCalibrationTemperature()
+{
+    return this->_phCalTemperature;
+}
+
+ECPHReading DFRobot_ESP_EC_PH::readECExtended(float voltage, float temperature)
+{
+    ECPHReading reading;
+    reading.value = readEC(voltage, temperature);
+    reading.range = this->_ecRangeHigh ? ECPH_RANGE_HIGH : ECPH_RANGE_LOW;
+    reading.flags = (ecCalibrated() ? ECPH_READING_CALIBRATED : 0)
+                  | ((voltage <= ECPH_VOLTAGE_SATURATION_LOW) ? ECPH_READING_SATURATED_LOW : 0)
+                  | ((voltage >= ECPH_VOLTAGE_SATURATION_HIGH) ? ECPH_READING_SATURATED_HIGH : 0);
+    reading.uncertainty = fabsf(reading.value) * ((ecCalibrated() ? EC_UNCERTAINTY_CALIBRATED : EC_UNCERTAINTY_UNCALIBRATED)
+                                                  + EC_UNCERTAINTY_PER_DEGREE * fabsf(temperature - 25.0));
+    return reading;
+}
+
+ECPHReading DFRobot_ESP_EC_PH::readPHExtended(float voltage, float temperature)
+{
+    ECPHReading reading;
+    reading.value = readPH(voltage, temperature);
+    reading.range = ECPH_RANGE_NONE;
+    reading.flags = (phCalibrated() ? ECPH_READING_CALIBRATED : 0)
+                  | ((voltage <= ECPH_VOLTAGE_SATURATION_LOW) ? ECPH_READING_SATURATED_LOW : 0)
+                  | ((voltage >= ECPH_VOLTAGE_SATURATION_HIGH) ? ECPH_READING_SATURATED_HIGH : 0)
+                  | ((temperature < PH_NERNST_TABLE_MIN || temperature > PH_NERNST_TABLE_MAX) ? ECPH_READING_TEMP_CLAMPED : 0);
+    reading.uncertainty = (phCalibrated() ? PH_UNCERTAINTY_CALIBRATED : PH_UNCERTAINTY_UNCALIBRATED)
+                        + PH_UNCERTAINTY_PER_DEGREE * fabsf(temperature - this->_phCalTemperature) * fabsf(reading.value - 7.0);
+    return reading;
+}
+
+bool DFRobot_ESP_EC_PH::readFromSource(ECPHAdcSource &source, float temperature, float &ec, float &ph)
+{
+    size_t count = source.readBlock(this->_ecBlock, this->_phBlock, ECPH_ADC_BLOCK_SIZE);
+    if (count == 0)
+    {
+        return false;
+    }
+    float ecSum = 0, phSum = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        ecSum += this->_ecBlock[i];
+        phSum += this->_phBlock[i];
+    }
+    this->_ecvoltage = ecSum / count; //averaged block voltages, also used by CALEC/CALPH
+    this->_phvoltage = phSum / count;
+    ec = readEC(this->_ecvoltage, temperature);
+    ph = readPH(this->_phvoltage, temperature);
+    return true;
+}
+
 void DFRobot_ESP_EC_PH::ECcalibration(float voltage, float temperature, char *cmd)
 {
     this->_ecvoltage = voltage;
     this->_temperature = temperature;
     strupr(cmd);
+    this->_activePort = NULL;
+    this->_cmdStream = (this->_portCount > 0) ? this->_ports[0].stream : &Serial;
     Calibration(cmdParse(cmd)); // if received Serial CMD from the serial monitor, enter into the calibration mode
 }
 
@@ -165,9 +477,9 @@ void DFRobot_ESP_EC_PH::ECcalibration(float voltage, float temperature)
 {
     this->_ecvoltage = voltage;
     this->_temperature = temperature;
-    if (cmdSerialDataAvailable() > 0)
+    while (cmdSerialDataAvailable() > 0)
     {
-        Calibration(cmdParse()); // if received Serial CMD from the serial monitor, enter into the calibration mode
+        Calibration(cmdParse()); // if received a CMD from any command stream, enter into the calibration mode
     }
 }
 
@@ -176,6 +488,8 @@ void DFRobot_ESP_EC_PH::PHcalibration(float voltage, float temperature, char *cm
     this->_phvoltage = voltage;
     this->_temperature = temperature;
     strupr(cmd);
+    this->_activePort = NULL;
+    this->_cmdStream = (this->_portCount > 0) ? this->_ports[0].stream : &Serial;
     Calibration(cmdParse(cmd)); // if received Serial CMD from the serial monitor, enter into the calibration mode
 }
 
@@ -183,632 +497,739 @@ void DFRobot_ESP_EC_PH::PHcalibration(float voltage, float temperature)
 {
     this->_phvoltage = voltage;
     this->_temperature = temperature;
-    if (cmdSerialDataAvailable() > 0)
+    while (cmdSerialDataAvailable() > 0)
     {
-        Calibration(cmdParse()); // if received Serial CMD from the serial monitor, enter into the calibration mode
+        Calibration(cmdParse()); // if received a CMD from any command stream, enter into the calibration mode
     }
 }
 
 void DFRobot_ESP_EC_PH::update()
 {
-    if (cmdSerialDataAvailable() > 0)
+    while (cmdSerialDataAvailable() > 0)
     {
-        Calibration(cmdParse()); // if received Serial CMD from the serial monitor, enter into the calibration mode
+        Calibration(cmdParse()); // if received a CMD from any command stream, enter into the calibration mode
     }
 }
 
 void DFRobot_ESP_EC_PH::nutrientpump()
 {
-    if (cmdSerialDataAvailable() > 0)
+    while (cmdSerialDataAvailable() > 0)
     {
-        Calibration(cmdParse()); // if received Serial CMD from the serial monitor, enter into the calibration mode
+        Calibration(cmdParse()); // if received a CMD from any command stream, enter into the calibration mode
     }
 }
 
-boolean DFRobot_ESP_EC_PH::cmdSerialDataAvailable()
+bool DFRobot_ESP_EC_PH::addCommandPort(Stream &stream)
 {
-    char cmdReceivedChar;
-    static unsigned long cmdReceivedTimeOut = millis();
-    while (Serial.available() > 0)
+    if (this->_portCount >= ECPH_MAX_COMMAND_PORTS)
     {
-        if (millis() - cmdReceivedTimeOut > 500U)
-        {
-            this->_cmdReceivedBufferIndex = 0;
-            memset(this->_cmdReceivedBuffer, 0, (ReceivedBufferLength));
-        }
-        cmdReceivedTimeOut = millis();
-        cmdReceivedChar = Serial.read();
-        if (cmdReceivedChar == '\n' || this->_cmdReceivedBufferIndex == ReceivedBufferLength - 1)
+        return false;
+    }
+    CommandPort &port = this->_ports[this->_portCount++];
+    memset(&port, 0, sizeof(port));
+    port.stream = &stream;
+    port.lastReceived = this->_clock();
+    return true;
+}
+
+bool DFRobot_ESP_EC_PH::removeCommandPort(Stream &stream)
+{
+    for (byte i = 0; i < this->_portCount; i++)
+    {
+        if (this->_ports[i].stream == &stream)
         {
-            this->_cmdReceivedBufferIndex = 0;
-            strupr(this->_cmdReceivedBuffer);
+            for (byte j = i + 1; j < this->_portCount; j++)
+            {
+                this->_ports[j - 1] = this->_ports[j];
+            }
+            this->_portCount--;
+            this->_nextPort = 0;
+            this->_activePort = NULL;
+            if (this->_cmdStream == &stream)
+            {
+                this->_cmdStream = &Serial;
+            }
             return true;
         }
-        else
+    }
+    return false;
+}
+
+boolean DFRobot_ESP_EC_PH::cmdSerialDataAvailable()
+{
+    //round robin so one busy stream cannot starve the others
+    for (byte n = 0; n < this->_portCount; n++)
+    {
+        CommandPort &port = this->_ports[this->_nextPort];
+        this->_nextPort = (this->_nextPort + 1) % this->_portCount;
+        if (pollCommandPort(port))
         {
-            this->_cmdReceivedBuffer[this->_cmdReceivedBufferIndex] = cmdReceivedChar;
-            this->_cmdReceivedBufferIndex++;
+            this->_activePort = &port;
+            this->_cmdStream = port.stream; //reply on the stream the command came from
+            return true;
         }
     }
     return false;
 }
 
-byte DFRobot_ESP_EC_PH::cmdParse(const char *cmd)
+boolean DFRobot_ESP_EC_PH::pollCommandPort(CommandPort &port)
 {
-    byte modeIndex = 0;
-    if (strstr(cmd, "ENTEREC") != NULL)
+    while (true)
     {
-        modeIndex = 1;
+        if (port.rxHead == port.rxCount)
+        {
+            int available = port.stream->available();
+            if (available <= 0)
+            {
+                return false;
+            }
+            if ((uint32_t)(this->_clock() - port.lastReceived) > ECPH_CMD_TIMEOUT)
+            {
+                port.lineIndex = 0; //stale partial command
+            }
+            port.lastReceived = this->_clock();
+            port.rxHead = 0;
+            port.rxCount = port.stream->readBytes(port.rx, (available < ECPH_PORT_RX_LENGTH) ? available : ECPH_PORT_RX_LENGTH);
+            if (port.rxCount == 0)
+            {
+                return false;
+            }
+        }
+        while (port.rxHead < port.rxCount)
+        {
+            char cmdReceivedChar = port.rx[port.rxHead++];
+            if (cmdReceivedChar == '\n' || port.lineIndex == ReceivedBufferLength - 1)
+            {
+                port.line[port.lineIndex] = '\0';
+                port.lineIndex = 0;
+                strupr(port.line);
+                return true;
+            }
+            port.line[port.lineIndex++] = cmdReceivedChar;
+        }
     }
-    else if (strstr(cmd, "EXITEC") != NULL)
+}
+
+long DFRobot_ESP_EC_PH::cmdParseInt()
+{
+    //value lines follow their command on the same stream
+    if (this->_activePort == NULL)
     {
-        modeIndex = 3;
+        return this->_cmdStream->parseInt();
     }
-    else if (strstr(cmd, "CALEC") != NULL)
-    {    
-        modeIndex = 2;
+    //a client that went away must not hang the loop, the prompt then fails like a zero entry
+    unsigned long start = this->_clock();
+    while (!pollCommandPort(*this->_activePort))
+    {
+        if ((uint32_t)(this->_clock() - start) > ECPH_CMD_TIMEOUT)
+        {
+            return 0;
+        }
     }
-    else if (strstr(cmd, "ENTERPH") != NULL)
+    return atol(this->_activePort->line);
+}
+
+//swallows the per step console output of runBatch()
+class ECPHNullStream : public Stream
+{
+public:
+    int available() { return 0; }
+    int read() { return -1; }
+    int peek() { return -1; }
+    size_t write(uint8_t) { return 1; }
+};
+static ECPHNullStream batchNullStream;
+
+bool DFRobot_ESP_EC_PH::runBatch(const char *script)
+{
+    return runBatch(script, (this->_portCount > 0) ? *this->_ports[0].stream : Serial);
+}
+
+bool DFRobot_ESP_EC_PH::runBatch(const char *script, Stream &reply)
+{
+    struct BatchStep
     {
-        modeIndex = 4;
+        byte mode;
+        float voltage;
+        float temperature;
+    } steps[ECPH_BATCH_MAX_STEPS];
+    byte count = 0;
+    byte session = 0; //0 none, 1 EC, 2 PH while validating
+    const char *p = script;
+
+    //validate the whole script before touching any state
+    bool valid = (this->_calState == CAL_IDLE); //no interactive session in progress
+    while (valid && *p != '\0')
+    {
+        char token[ReceivedBufferLength];
+        byte n = 0;
+        while (*p == ' ' || *p == ';')
+        {
+            p++;
+        }
+        if (*p == '\0')
+        {
+            break;
+        }
+        while (*p != '\0' && *p != ';' && *p != '=' && n < ReceivedBufferLength - 1)
+        {
+            token[n++] = *p++;
+        }
+        token[n] = '\0';
+        strupr(token);
+        if (count == ECPH_BATCH_MAX_STEPS)
+        {
+            valid = false;
+            break;
+        }
+        BatchStep &step = steps[count++];
+        step.mode = cmdParse(token);
+        step.voltage = NAN;
+        step.temperature = NAN;
+        if (*p == '=')
+        {
+            char *end;
+            step.voltage = strtod(p + 1, &end);
+            valid = valid && (end != p + 1);
+            p = end;
+            if (*p == '@')
+            {
+                step.temperature = strtod(p + 1, &end);
+                valid = valid && (end != p + 1);
+                p = end;
+            }
+        }
+        if ((*p != '\0' && *p != ';') || (!isnan(step.voltage) && step.mode != 2 && step.mode != 5))
+        {
+            valid = false; //trailing garbage, or a reading attached to a step that takes none
+        }
+        switch (step.mode)
+        {
+        case 1: //ENTEREC
+        case 4: //ENTERPH
+            valid = valid && (session == 0);
+            session = (step.mode == 1) ? 1 : 2;
+            break;
+        case 2: //CALEC
+        case 5: //CALPH
+            valid = valid && (session == ((step.mode == 2) ? 1 : 2));
+            break;
+        case 3: //EXITEC
+        case 6: //EXITPH
+            valid = valid && (session == ((step.mode == 3) ? 1 : 2));
+            session = 0;
+            break;
+        case 7: //ECPHDOWN
+        case 8: //ECPHUP
+            valid = valid && (session == 0);
+            break;
+        default:
+            valid = false;
+            break;
+        }
     }
-    else if (strstr(cmd, "EXITPH") != NULL)
+    this->_cmdStream = &reply;
+    if (!valid || session != 0 || count == 0)
     {
-        modeIndex = 6;
+        printMessage(MSG_BATCH_INVALID);
+        this->_cmdStream->print(count);
+        printlnMessage(MSG_END);
+        return false;
     }
-    else if (strstr(cmd, "CALPH") != NULL)
+
+    //snapshot of everything a calibration script can change, for the rollback
+    float kvalue = this->_kvalue, kvalueLow = this->_kvalueLow, kvalueHigh = this->_kvalueHigh;
+    float neutralVoltage = this->_neutralVoltage, acidVoltage = this->_acidVoltage, phCalTemperature = this->_phCalTemperature;
+    float ecvoltage = this->_ecvoltage, phvoltage = this->_phvoltage, temperature = this->_temperature, rawEC = this->_rawEC;
+    boolean eccalibrated = this->_eccalibrated, phcalibrated = this->_phcalibrated, dosing = this->customBlink;
+    byte calibrationDefaults = this->_calibrationDefaults;
+    bool eepromDirty = this->_eepromDirty;
+
+    //execute silently, EXITEC/EXITPH only stage their values
+    byte failedStep = 0;
+    this->_batchActive = true;
+    this->_activePort = NULL;
+    this->_cmdStream = &batchNullStream;
+    for (byte i = 0; i < count && failedStep == 0; i++)
     {
-        modeIndex = 5;
+        if (!isnan(steps[i].temperature))
+        {
+            this->_temperature = steps[i].temperature;
+        }
+        if (!isnan(steps[i].voltage) && steps[i].mode == 2)
+        {
+            this->_ecvoltage = steps[i].voltage;
+            this->_rawEC = ecphRawEC(this->_ecvoltage);
+        }
+        else if (!isnan(steps[i].voltage) && steps[i].mode == 5)
+        {
+            this->_phvoltage = steps[i].voltage;
+        }
+        Calibration(steps[i].mode);
+        if (this->_cmdFailed)
+        {
+            failedStep = i + 1;
+        }
     }
-    else if (strstr(cmd, "ECPHDOWN") != NULL)
+
+    if (failedStep != 0)
     {
-        modeIndex = 7;
+        this->_calState = CAL_IDLE; //close the half open session
+        resetCalibrationSession();
+        this->_kvalue = kvalue;
+        this->_kvalueLow = kvalueLow;
+        this->_kvalueHigh = kvalueHigh;
+        this->_neutralVoltage = neutralVoltage;
+        this->_acidVoltage = acidVoltage;
+        this->_phCalTemperature = phCalTemperature;
+        this->_ecvoltage = ecvoltage;
+        this->_phvoltage = phvoltage;
+        this->_temperature = temperature;
+        this->_rawEC = rawEC;
+        this->_eccalibrated = eccalibrated;
+        this->_phcalibrated = phcalibrated;
+        this->_calibrationDefaults = calibrationDefaults;
+        this->customBlink = dosing;
+        updatePHModel();
+        //put the EEPROM cache back as well, values staged by an EXIT step must not leak into a later commit
+        stageCalibration(STAGE_ALL);
+        this->_eepromDirty = eepromDirty;
     }
-    else if (strstr(cmd, "ECPHUP") != NULL)
+    this->_batchActive = false;
+    this->_cmdStream = &reply;
+
+    if (failedStep != 0)
     {
-        modeIndex = 8;
+        printMessage(MSG_BATCH_ROLLED_BACK);
+        this->_cmdStream->print(failedStep);
+        printlnMessage(MSG_END);
+        return false;
     }
-    return modeIndex;
+    bool saved = flush(); //the single commit of the whole script
+    printMessage(saved ? MSG_BATCH_OK : MSG_BATCH_NOT_SAVED);
+    this->_cmdStream->print(count);
+    printlnMessage(MSG_END);
+    return saved;
 }
 
-byte DFRobot_ESP_EC_PH::cmdParse()
+byte DFRobot_ESP_EC_PH::cmdParse(const char *cmd)
 {
     byte modeIndex = 0;
-    if (strstr(this->_cmdReceivedBuffer, "ENTEREC") != NULL)
+    if (strstr(cmd, "ENTEREC") != NULL)
     {
         modeIndex = 1;
     }
-    else if (strstr(this->_cmdReceivedBuffer, "EXITEC") != NULL)
+    else if (strstr(cmd, "EXITEC") != NULL)
     {
         modeIndex = 3;
     }
-    else if (strstr(this->_cmdReceivedBuffer, "CALEC") != NULL)
-    {
+    else if (strstr(cmd, "CALEC") != NULL)
+    {    
         modeIndex = 2;
     }
-    else if (strstr(this->_cmdReceivedBuffer, "ENTERPH") != NULL)
+    else if (strstr(cmd, "ENTERPH") != NULL)
     {
         modeIndex = 4;
     }
-    else if (strstr(this->_cmdReceivedBuffer, "EXITPH") != NULL)
+    else if (strstr(cmd, "EXITPH") != NULL)
     {
         modeIndex = 6;
     }
-    else if (strstr(this->_cmdReceivedBuffer, "CALPH") != NULL)
+    else if (strstr(cmd, "CALPH") != NULL)
     {
         modeIndex = 5;
     }
-    else if (strstr(this->_cmdReceivedBuffer, "ECPHDOWN") != NULL)
+    else if (strstr(cmd, "ECPHDOWN") != NULL)
     {
         modeIndex = 7;
     }
-    else if (strstr(this->_cmdReceivedBuffer, "ECPHUP") != NULL)
+    else if (strstr(cmd, "ECPHUP") != NULL)
     {
         modeIndex = 8;
     }
     return modeIndex;
 }
 
+byte DFRobot_ESP_EC_PH::cmdParse()
+{
+    return cmdParse(this->_activePort->line);
+}
+
+//----- Calibration transition table -----
+//every (state, command) pair has an entry, the action runs before the state changes
+struct CalTransition
+{
+    byte action;
+    byte next;
+};
+
+#define T(action, next) {ACT_##action, CAL_##next}
+static const CalTransition calTransitions[CAL_STATE_COUNT][CAL_COMMAND_COUNT] = {
+    //unknown                ENTEREC                         CALEC                  EXITEC                  ENTERPH                     CALPH                  EXITPH                  ECPHDOWN              ECPHUP              -              pump on time                pump off time               pump exit
+    {T(NONE, IDLE),          T(ENTER_EC, EC),                T(WRONG_CAL, IDLE),    T(WRONG_EXIT, IDLE),    T(ENTER_PH, PH),            T(WRONG_CAL, IDLE),    T(WRONG_EXIT, IDLE),    T(DOSE_DOWN, IDLE),   T(DOSE_UP, IDLE),   T(NONE, IDLE), T(PUMP_ON, PUMP),           T(PUMP_OFF, PUMP),          T(WRONG_EXIT, IDLE)}, //CAL_IDLE
+    {T(COMMAND_ERROR, IDLE), T(ENTER_EC, EC),                T(CAL_EC, EC),         T(EXIT_EC, IDLE),       T(MULTIPLE_COMMAND, IDLE),  T(WRONG_CAL, IDLE),    T(WRONG_EXIT, IDLE),    T(DOSE_DOWN, EC),     T(DOSE_UP, EC),     T(NONE, EC),   T(MULTIPLE_COMMAND, IDLE),  T(MULTIPLE_COMMAND, IDLE),  T(WRONG_EXIT, IDLE)}, //CAL_EC
+    {T(COMMAND_ERROR, IDLE), T(MULTIPLE_CALIBRATION, IDLE),  T(WRONG_CAL, IDLE),    T(WRONG_EXIT, IDLE),    T(ENTER_PH, PH),            T(CAL_PH, PH),         T(EXIT_PH, IDLE),       T(DOSE_DOWN, PH),     T(DOSE_UP, PH),     T(NONE, PH),   T(MULTIPLE_COMMAND, IDLE),  T(MULTIPLE_COMMAND, IDLE),  T(WRONG_EXIT, IDLE)}, //CAL_PH
+    {T(NONE, PUMP),          T(MULTIPLE_CALIBRATION, IDLE),  T(WRONG_CAL, IDLE),    T(WRONG_EXIT, IDLE),    T(MULTIPLE_COMMAND, IDLE),  T(WRONG_CAL, IDLE),    T(WRONG_EXIT, IDLE),    T(DOSE_DOWN, PUMP),   T(DOSE_UP, PUMP),   T(NONE, PUMP), T(PUMP_ON, PUMP),           T(PUMP_OFF, PUMP),          T(PUMP_EXIT, IDLE)},  //CAL_PUMP
+};
+#undef T
+
+static const byte calStateMode[CAL_STATE_COUNT] = {0, 1, 2, 4}; //legacy calmode of each state
+
 void DFRobot_ESP_EC_PH::Calibration(byte mode)
 {
-    char *receivedBufferPtr;
-    static boolean ecCalibrationFinish = 0;
-    static boolean ecenterCalibrationFlag = 0;
-    static boolean phCalibrationFinish = 0;
-    static boolean phenterCalibrationFlag = 0;
-    static boolean lightonset = 0;
-    static boolean lightonsetfinish = 0;
-    static boolean lightoffset = 0;
-    static boolean lightoffsetfinish = 0;
-    static boolean pumponset = 0;
-    static boolean pumponsetfinish = 0;
-    static boolean pumpoffset = 0;
-    static boolean pumpoffsetfinish = 0;
-
-    static float compECsolution;
+    if (mode >= CAL_COMMAND_COUNT)
+    {
+        mode = 0;
+    }
+    const CalTransition &transition = calTransitions[this->_calState][mode];
+    this->_cmdFailed = false;
+    calibrationAction(transition.action);
+    this->_calState = transition.next;
+}
+
+int DFRobot_ESP_EC_PH::getCalibrationMode()
+{
+    return calStateMode[this->_calState];
+}
+
+void DFRobot_ESP_EC_PH::resetCalibrationSession()
+{
+    this->_calPoints = 0;
+    this->_calPointDone = false;
+    nonmode = 0;
+    noffmode = 0;
+}
+
+void DFRobot_ESP_EC_PH::calibrationAction(byte action)
+{
+    float compECsolution;
     float KValueTemp;
-    static boolean phcalibrated, eccalibrated;
-    int parsedOffTime;
-    int parsedOnTime;
-    int nparsedOnTime;
-    int nparsedOffTime;
-    switch (mode)
-    {
-    case 0:
-        if (ecenterCalibrationFlag || phenterCalibrationFlag)
-        {
-            Serial.println(F(">>>Command Error<<<"));
-            //this->_eccalibrated = false; // Calibration failed, set _calibrated to false
-            this->_phcalibrated = false; // Calibration failed, set _calibrated to false
-            ecenterCalibrationFlag = 0;
-            phenterCalibrationFlag = 0;
-            calmode = 0; //uncalibration mode
-        }
+    int parsedTime;
+    switch (action)
+    {
+    case ACT_NONE:
         break;
 
-    case 1://ENTEREC prompt
-        ecenterCalibrationFlag = 1;
-        ecCalibrationFinish = 0;
-        calmode = 1; //PH calibration mode triggered
-        if (!phenterCalibrationFlag || !lightoffset || !lightonset || !pumponset || !pumpoffset){ //when the next input prompt is not "ENTERPH" or "ONLIGHT" or "OFFLIGHT"
-        Serial.println();
-        Serial.println(F(">>>Enter EC Calibration Mode<<<"));
-        Serial.println(F(">>>Please put the probe into the 1413us/cm or 2.76ms/cm or 12.88ms/cm buffer solution<<<"));
-        Serial.println(F(">>>Only need two point for calibration one low (1413us/com) and one high(2.76ms/cm or 12.88ms/cm)<<<"));
-        Serial.println();
-        this->_eccalibrated = false; // EC calibration failed
-        }
-        else{ //when the next input prompt is "ENTERPH" or "ONLIGHT" or "OFFLIGHT"
-            calmode = 0;
-            phenterCalibrationFlag = 0;
-            phCalibrationFinish = 0;
-            ecCalibrationFinish = 0;
-            ecenterCalibrationFlag = 0;
-            pumponset = 0;
-            pumponsetfinish = 0;
-            pumpoffsetfinish = 0;
-            pumpoffset = 0;
-            lightonset = 0;
-            lightonsetfinish = 0;
-            lightoffset = 0;
-            lightoffsetfinish = 0;
-            Serial.println(F(">>>Multiple calibration command detected.<<<"));
-        }
+    case ACT_COMMAND_ERROR:
+        printlnMessage(MSG_COMMAND_ERROR);
+        this->_cmdFailed = true;
+        resetCalibrationSession();
+        break;
+
+    case ACT_MULTIPLE_CALIBRATION: //a session was opened while another one is running
+        printlnMessage(MSG_MULTIPLE_CALIBRATION);
+        this->_cmdFailed = true;
+        resetCalibrationSession();
+        break;
+
+    case ACT_MULTIPLE_COMMAND:
+        printlnMessage(MSG_MULTIPLE_COMMAND);
+        this->_cmdFailed = true;
+        resetCalibrationSession();
+        break;
+
+    case ACT_WRONG_CAL: //CAL without the matching ENTER
+        printlnMessage(MSG_WRONG_CAL);
+        this->_cmdFailed = true;
+        resetCalibrationSession();
+        break;
+
+    case ACT_WRONG_EXIT: //EXIT without the matching ENTER
+        printlnMessage(MSG_WRONG_EXIT);
+        this->_cmdFailed = true;
+        resetCalibrationSession();
+        break;
 
+    case ACT_ENTER_EC: //"ENTEREC" prompt
+        resetCalibrationSession();
+        this->_cmdStream->println();
+        printlnMessage(MSG_EC_ENTER);
+        printlnMessage(MSG_EC_PROBE_HINT);
+        printlnMessage(MSG_EC_TWO_POINT_HINT);
+        this->_cmdStream->println();
+        this->_eccalibrated = false; // EC calibration restarted
         break;
 
-    case 2://CALEC prompt
-        if (ecenterCalibrationFlag && calmode == 1) //after "ENTEREC" is prompted
+    case ACT_CAL_EC: //"CALEC" prompt
+        if ((this->_rawEC > RAWEC_1413_LOW) && (this->_rawEC < RAWEC_1413_HIGH))
+        {
+            printMessage(MSG_EC_BUFFER_1413);                                      //recognize 1.413us/cm buffer solution
+            compECsolution = 1.413 * (1.0 + 0.0185 * (this->_temperature - 25.0)); //temperature compensation
+        }
+        else if ((this->_rawEC > RAWEC_276_LOW) && (this->_rawEC < RAWEC_276_HIGH))
         {
+            printMessage(MSG_EC_BUFFER_276);                                      //recognize 2.76ms/cm buffer solution
+            compECsolution = 2.76 * (1.0 + 0.0185 * (this->_temperature - 25.0)); //temperature compensation
+        }
+        else if ((this->_rawEC > RAWEC_1288_LOW) && (this->_rawEC < RAWEC_1288_HIGH))
+        {
+            printMessage(MSG_EC_BUFFER_1288);                                      //recognize 12.88ms/cm buffer solution
+            compECsolution = 12.88 * (1.0 + 0.0185 * (this->_temperature - 25.0)); //temperature compensation
+        }
+        else
+        {
+            printMessage(MSG_BUFFER_ERROR);
+            this->_cmdStream->println();
+            this->_cmdFailed = true;
+            this->_calPointDone = false;
+            break; //user can prompt "CALEC" to retry, the session stays open
+        }
+        printMessage(MSG_COMP_EC_SOLUTION);
+        this->_cmdStream->print(compECsolution);
+        printlnMessage(MSG_END);
+        this->_cmdStream->println();
+        printlnMessage(MSG_KVALUE_FORMULA);
+        printMessage(MSG_KVALUE_CALCULATION);
+        this->_cmdStream->print(RES2);
+        printMessage(MSG_MUL);
+        this->_cmdStream->print(ECREF);
+        printMessage(MSG_MUL);
+        this->_cmdStream->print(compECsolution);
+        printMessage(MSG_DIV_1000);
+        this->_cmdStream->print(this->_ecvoltage);
+        printlnMessage(MSG_END);
+        KValueTemp = RES2 * ECREF * compECsolution / 1000.0 / this->_ecvoltage; //calibrate the k value
+        this->_cmdStream->println();
+        printMessage(MSG_KVALUE_TEMP);
+        this->_cmdStream->print(KValueTemp);
+        printlnMessage(MSG_END);
+        if ((KValueTemp > 0.5) && (KValueTemp < 2.0))
+        {
+            this->_cmdStream->println();
+            printMessage(MSG_EC_SUCCESS_K);
+            this->_cmdStream->print(KValueTemp);
+            printlnMessage(MSG_EC_SEND_EXIT);
             if ((this->_rawEC > RAWEC_1413_LOW) && (this->_rawEC < RAWEC_1413_HIGH))
             {
-                Serial.print(F(">>>Buffer 1.413ms/cm<<<"));                            //recognize 1.413us/cm buffer solution
-                compECsolution = 1.413 * (1.0 + 0.0185 * (this->_temperature - 25.0)); //temperature compensation
-                Serial.print(F(">>>compECsolution: "));
-                Serial.print(compECsolution);
-                Serial.println(F("<<<"));
-                cal1 = 1; //1.413us/cm buffer detection flag triggered
-            }
-            else if ((this->_rawEC > RAWEC_276_LOW) && (this->_rawEC < RAWEC_276_HIGH))
-            {
-                Serial.print(F(">>>Buffer 2.76ms/cm<<<"));                            //recognize 2.76ms/cm buffer solution
-                compECsolution = 2.76 * (1.0 + 0.0185 * (this->_temperature - 25.0)); //temperature compensation
-                Serial.print(F(">>>compECsolution: "));
-                Serial.print(compECsolution);
-                Serial.println(F("<<<"));
-                cal2 = 1; //2.76ms/cm buffer detection flag triggered
-            }
-            else if ((this->_rawEC > RAWEC_1288_LOW) && (this->_rawEC < RAWEC_1288_HIGH))
-            {
-                Serial.print(F(">>>Buffer 12.88ms/cm<<<"));                            //recognize 12.88ms/cm buffer solution
-                compECsolution = 12.88 * (1.0 + 0.0185 * (this->_temperature - 25.0)); //temperature compensation
-                Serial.print(F(">>>compECsolution: "));
-                Serial.print(compECsolution);
-                Serial.println(F("<<<"));
-                cal2 = 1; //12.88ms/cm buffer detection flag triggered
-            }
-            else
-            {
-                Serial.print(F(">>>Buffer Solution Error Try Again<<<   "));
-                ecCalibrationFinish = 0;
-                cal1 = 0; //deactivate buffer detection flag
-                cal2 = 0; //deactivate buffer detection flag
-                //user can prompt "CALEC" to retry EC calibration since ecenterCalibrationFlag is still HIGH
-            }
-            Serial.println();
-            Serial.print(F(">>>KValueTemp calculation formule: "));
-            Serial.print(F("RES2"));
-            Serial.print(F(" * "));
-            Serial.print(F("ECREF"));
-            Serial.print(F(" * "));
-            Serial.print(F("compECsolution"));
-            Serial.print(F(" / 1000.0 / "));
-            Serial.print(F("voltage"));
-            Serial.println(F("<<<"));
-            Serial.print(F(">>>KValueTemp calculation: "));
-            Serial.print(RES2);
-            Serial.print(F(" * "));
-            Serial.print(ECREF);
-            Serial.print(F(" * "));
-            Serial.print(compECsolution);
-            Serial.print(F(" / 1000.0 / "));
-            Serial.print(this->_ecvoltage);
-            Serial.println(F("<<<"));
-            KValueTemp = RES2 * ECREF * compECsolution / 1000.0 / this->_ecvoltage; //calibrate the k value
-            Serial.println();
-            Serial.print(F(">>>KValueTemp: "));
-            Serial.print(KValueTemp);
-            Serial.println(F("<<<"));
-            if ((KValueTemp > 0.5) && (KValueTemp < 2.0))
-            {
-                Serial.println();
-                Serial.print(F(">>>Successful,K:"));
-                Serial.print(KValueTemp);
-                Serial.println(F(", Send EXITEC to Save and Exit<<<"));
-                if ((this->_rawEC > RAWEC_1413_LOW) && (this->_rawEC < RAWEC_1413_HIGH))
-                {
-                    this->_kvalueLow = KValueTemp;
-                    Serial.print(">>>kvalueHigh: ");
-                    Serial.print(this->_kvalueLow);
-                    Serial.println(F("<<<"));
-                }
-                else if ((this->_rawEC > RAWEC_276_LOW) && (this->_rawEC < RAWEC_276_HIGH))
-                {
-                    this->_kvalueHigh = KValueTemp;
-                    Serial.print(">>>kvalueHigh: ");
-                    Serial.print(this->_kvalueHigh);
-                    Serial.println(F("<<<"));
-                }
-                else if ((this->_rawEC > RAWEC_1288_LOW) && (this->_rawEC < RAWEC_1288_HIGH))
-                {
-                    this->_kvalueHigh = KValueTemp;
-                    Serial.print(">>>kvalueHigh: ");
-                    Serial.print(this->_kvalueHigh);
-                    Serial.println(F("<<<"));
-                }
-                ecCalibrationFinish = 1;
+                this->_kvalueLow = KValueTemp;
+                this->_calPoints |= CAL_POINT_EC_LOW;
             }
             else
             {
-                Serial.println();
-                Serial.println(F(">>>KValueTemp out of range 0.5-2.0<<<"));
-                Serial.print(">>>KValueTemp: ");
-                Serial.print(KValueTemp, 4);
-                Serial.println("<<<");
-                Serial.println(F(">>>Failed,Try Again<<<"));
-                Serial.println();
-                ecCalibrationFinish = 0;
-                this->_eccalibrated = false; //Failed EC calibration
+                this->_kvalueHigh = KValueTemp;
+                this->_calPoints |= CAL_POINT_EC_HIGH;
             }
+            printMessage(MSG_KVALUE_HIGH);
+            this->_cmdStream->print(KValueTemp);
+            printlnMessage(MSG_END);
+            this->_calPointDone = true;
         }
-        else {
-            Serial.println(">>Wrong CAL command detected.<<<");
-            calmode = 0;
+        else
+        {
+            this->_cmdStream->println();
+            printlnMessage(MSG_KVALUE_OUT_OF_RANGE);
+            printMessage(MSG_KVALUE_TEMP);
+            this->_cmdStream->print(KValueTemp, 4);
+            printlnMessage(MSG_END);
+            printlnMessage(MSG_FAILED_TRY_AGAIN);
+            this->_cmdStream->println();
+            this->_cmdFailed = true;
+            this->_calPointDone = false;
+            this->_eccalibrated = false; //Failed EC calibration
         }
         break;
-    case 3://"EXITEC" prompt
-        if (ecenterCalibrationFlag && calmode == 1)
-        {
-            Serial.println();
-            if (ecCalibrationFinish)
-            {
-                if ((this->_rawEC > RAWEC_1413_LOW) && (this->_rawEC < RAWEC_1413_HIGH))
-                {
-                    EEPROM.writeFloat(this->_eceepromStartAddress, this->_kvalueLow);
-                    EEPROM.commit();
-                }
-                else if ((this->_rawEC > RAWEC_276_LOW) && (this->_rawEC < RAWEC_276_HIGH))
-                {
-                    EEPROM.writeFloat(this->_eceepromStartAddress + (int)sizeof(float), this->_kvalueHigh);
-                    EEPROM.commit();
-                }
-                else if ((this->_rawEC > RAWEC_1288_LOW) && (this->_rawEC < RAWEC_1288_HIGH))
-                {
-                    EEPROM.writeFloat(this->_eceepromStartAddress + (int)sizeof(float), this->_kvalueHigh);
-                    EEPROM.commit();
-                }
-                Serial.print(F(">>>Calibration Successful"));
-            }
-            else
-            {
-                Serial.print(F(">>>Calibration Failed"));
-                //this->_eccalibrated = false; // Calibration is successful, set _calibrated to true
-            }
-
-            Serial.println(F(",Exit EC Calibration Mode<<<"));
-            Serial.println();
-            ecCalibrationFinish = 0;
-            ecenterCalibrationFlag = 0;
-            if (cal1 == 1 and cal2 ==1){ //2 different buffer solution has been detected and calibrated
-            this->_eccalibrated = true; //Successful EC calibration
-            cal1 =0; //deactivate buffer detection flag 
-            cal2=0; //detect buffer solution flag
-            calmode = 0; //back to uncalibrated mode 
 
-            }
-            else { //only one or no buffer solution has been detected or calibrated
-                cal1 = 0; //deactivate buffer detection flag
-                cal2 = 0; //deactivate buffer detection flag
-                calmode =0; //back to uncalibrated mode
-                this->_eccalibrated = false; // Failed EC calibration
-            }
+    case ACT_EXIT_EC: //"EXITEC" prompt
+        this->_cmdStream->println();
+        if (this->_calPointDone)
+        {
+            //save both K values, a session may have calibrated the low and the high point
+            this->_calibrationDefaults &= ~(((this->_calPoints & CAL_POINT_EC_LOW) ? ECPH_DEFAULT_KVALUE_LOW : 0)
+                                          | ((this->_calPoints & CAL_POINT_EC_HIGH) ? ECPH_DEFAULT_KVALUE_HIGH : 0));
+            stageCalibration(STAGE_EC);
+            printMessage(MSG_CAL_SUCCESSFUL);
         }
-        else {
-            Serial.println(">>>Wrong EXIT command detected.<<<");
-            calmode = 0;
+        else
+        {
+            printMessage(MSG_CAL_FAILED);
+            this->_cmdFailed = true;
         }
+        printlnMessage(MSG_EC_EXIT);
+        this->_cmdStream->println();
+        //EC is calibrated once both a low and a high buffer have been calibrated
+        this->_eccalibrated = (this->_calPoints & (CAL_POINT_EC_LOW | CAL_POINT_EC_HIGH)) == (CAL_POINT_EC_LOW | CAL_POINT_EC_HIGH);
+        resetCalibrationSession();
         break;
 
-    case 4: //"ENTERPH" prompt
-        phenterCalibrationFlag = 1;
-        phCalibrationFinish = 0;
-        calmode = 2; //PH calibration mode
-        if (!ecenterCalibrationFlag || !lightoffset || !lightonset || !pumponset || !pumpoffset){ //when "ENTEREC" is not prompted
-        Serial.println();
-        Serial.println(F(">>>Enter PH Calibration Mode<<<"));
-        Serial.println(F(">>>Please put the probe into the 4.0 or 7.0 standard buffer solution<<<"));
-        Serial.println();
-        this->_phcalibrated = false; // Calibration failed, set _calibrated to false
-        }
-        else { //when "ENTEREC" is prompted
-            calmode = 0;
-            phenterCalibrationFlag = 0;
-            phCalibrationFinish = 0;
-            ecCalibrationFinish = 0;
-            ecenterCalibrationFlag = 0;
-            pumponset = 0;
-            pumponsetfinish = 0;
-            pumpoffsetfinish = 0;
-            pumpoffset = 0;
-            lightonset = 0;
-            lightonsetfinish = 0;
-            lightoffset = 0;
-            lightoffsetfinish = 0;
-            Serial.println(F(">>>Multiple command detected.<<<"));
-        }
+    case ACT_ENTER_PH: //"ENTERPH" prompt
+        resetCalibrationSession();
+        this->_cmdStream->println();
+        printlnMessage(MSG_PH_ENTER);
+        printlnMessage(MSG_PH_PROBE_HINT);
+        this->_cmdStream->println();
+        this->_phcalibrated = false; // pH calibration restarted
         break;
 
-    case 5: //"CALPH" prompt
-        if (phenterCalibrationFlag && calmode == 2)
+    case ACT_CAL_PH: //"CALPH" prompt
+        this->_cmdStream->println();
+        if (!calibrationTemperatureValid(this->_temperature))
         {
-            // buffer solution:7.0
-            // 7795 to 1250
-            if ((this->_phvoltage > PH_VOLTAGE_NEUTRAL_LOW_LIMIT) && (this->_phvoltage < PH_VOLTAGE_NEUTRAL_HIGH_LIMIT))
-            {
-                Serial.println();
-                Serial.print(F(">>>Buffer Solution:7.0"));
-                this->_neutralVoltage = this->_phvoltage;
-                Serial.println(F(",Send EXITPH to Save and Exit<<<"));
-                Serial.println();
-                phCalibrationFinish = 1;
-                cal3 = 1; //buffer solution 1 detected
-            }
-            //buffer solution:4.0
-            //1180 to 1700
-            else if ((this->_phvoltage > PH_VOLTAGE_ACID_LOW_LIMIT) && (this->_phvoltage < PH_VOLTAGE_ACID_HIGH_LIMIT))
-            {
-                Serial.println();
-                Serial.print(F(">>>Buffer Solution:4.0"));
-                this->_acidVoltage = this->_phvoltage;
-                Serial.println(F(",Send EXITPH to Save and Exit<<<"));
-                Serial.println();
-                phCalibrationFinish = 1;
-                cal4 = 1; //buffer solution 2 detected
-            }
-            else
-            {
-                Serial.println();
-                Serial.print(F(">>>Buffer Solution Error Try Again<<<"));
-                Serial.println(); // not buffer solution or faulty operation
-                phCalibrationFinish = 0;
-                //user can prompt "CALPH" to retry PH calibration since phenterCalibrationFlag is still HIGH
-            }
+            printlnMessage(MSG_PH_TEMPERATURE_ERROR);
+            this->_cmdFailed = true;
+            this->_calPointDone = false;
+            break; //nothing changed, the session stays open
         }
-        else {
-            Serial.println(">>Wrong CAL command detected.<<<");
-            calmode = 0;
+        // buffer solution:7.0
+        // 7795 to 1250
+        if ((this->_phvoltage > PH_VOLTAGE_NEUTRAL_LOW_LIMIT) && (this->_phvoltage < PH_VOLTAGE_NEUTRAL_HIGH_LIMIT))
+        {
+            printMessage(MSG_PH_BUFFER_7);
+            this->_neutralVoltage = this->_phvoltage;
+            this->_calPoints |= CAL_POINT_PH_NEUTRAL;
+        }
+        //buffer solution:4.0
+        //1180 to 1700
+        else if ((this->_phvoltage > PH_VOLTAGE_ACID_LOW_LIMIT) && (this->_phvoltage < PH_VOLTAGE_ACID_HIGH_LIMIT))
+        {
+            printMessage(MSG_PH_BUFFER_4);
+            this->_acidVoltage = this->_phvoltage;
+            this->_calPoints |= CAL_POINT_PH_ACID;
+        }
+        else
+        {
+            printMessage(MSG_BUFFER_ERROR);
+            this->_cmdStream->println(); // not buffer solution or faulty operation
+            this->_cmdFailed = true;
+            this->_calPointDone = false;
+            break; //user can prompt "CALPH" to retry, the session stays open
         }
+        this->_phCalTemperature = this->_temperature;
+        updatePHModel();
+        printlnMessage(MSG_PH_SEND_EXIT);
+        this->_cmdStream->println();
+        this->_calPointDone = true;
         break;
 
-    case 6: //EXITPH prompt
-        if (phenterCalibrationFlag && calmode == 2)
+    case ACT_EXIT_PH: //"EXITPH" prompt
+        this->_cmdStream->println();
+        if (this->_calPointDone)
         {
-            Serial.println();
-            if (phCalibrationFinish)
-            {
-                // buffer solution:7.0
-                // 7795 to 1250
-                if ((this->_phvoltage > PH_VOLTAGE_NEUTRAL_LOW_LIMIT) && (this->_phvoltage < PH_VOLTAGE_NEUTRAL_HIGH_LIMIT))
-                {
-                    EEPROM.writeFloat(this->_pheepromStartAddress, this->_neutralVoltage);
-                    EEPROM.commit();
-                }
-                //buffer solution:4.0
-                //1180 to 1700
-                else if ((this->_phvoltage > PH_VOLTAGE_ACID_LOW_LIMIT) && (this->_phvoltage < PH_VOLTAGE_ACID_HIGH_LIMIT))
-                {
-                    EEPROM.writeFloat(this->_pheepromStartAddress + (int)sizeof(float), this->_acidVoltage);
-                    EEPROM.commit();
-                }
-                Serial.print(F(">>>Calibration Successful"));
-            }
-            else
-            {
-                Serial.print(F(">>>Calibration Failed"));
-                this->_phcalibrated = false; // Failed PH calibration
-                //phcalibrated = 0;
-            }
-            Serial.println(F(",Exit PH Calibration Mode<<<"));
-            Serial.println();
-            phCalibrationFinish = 0;
-            phenterCalibrationFlag = 0;
-            if (cal3 == 1 and cal4 ==1){ //when two buffer solutions are detected and calibrated
-                this->_phcalibrated = true; // Calibration is successful
-                calmode = 0;
-                cal3=0;
-                cal4=0;
-            }
-            else {//if only one or no buffer solution is detected
-                cal3 = 0; //buffer detection flag reset
-                cal4 = 0; //buffer detection flag reset
-                calmode =0; //back to uncalibrated mode
-                this->_phcalibrated = false; // Failed PH calibration
-            }
-            
+            //save both buffer voltages, a session may have calibrated pH 7.0 and pH 4.0
+            this->_calibrationDefaults &= ~(((this->_calPoints & CAL_POINT_PH_NEUTRAL) ? ECPH_DEFAULT_NEUTRAL_VOLTAGE : 0)
+                                          | ((this->_calPoints & CAL_POINT_PH_ACID) ? ECPH_DEFAULT_ACID_VOLTAGE : 0)
+                                          | ECPH_DEFAULT_PH_CAL_TEMPERATURE);
+            stageCalibration(STAGE_PH);
+            printMessage(MSG_CAL_SUCCESSFUL);
         }
-        else {
-            Serial.println(">>>Wrong EXIT command detected.<<<");
-            calmode = 0;
+        else
+        {
+            printMessage(MSG_CAL_FAILED);
+            this->_cmdFailed = true;
         }
+        printlnMessage(MSG_PH_EXIT);
+        this->_cmdStream->println();
+        //pH is calibrated once both buffers have been calibrated
+        this->_phcalibrated = (this->_calPoints & (CAL_POINT_PH_NEUTRAL | CAL_POINT_PH_ACID)) == (CAL_POINT_PH_NEUTRAL | CAL_POINT_PH_ACID);
+        resetCalibrationSession();
         break;
-    
-    case 7:
+
+    case ACT_DOSE_DOWN: //"ECPHDOWN"
         customBlink = true;
+        resetSampleInterval(); //dosing changes the reservoir, sample fast again
         break;
-    case 8:
+
+    case ACT_DOSE_UP: //"ECPHUP"
         customBlink = false;
+        resetSampleInterval(); //dosing changes the reservoir, sample fast again
         break;
-    case 9:
-    break;
-
-    case 10:
-        pumponset = 1;
-        pumponsetfinish = 0;
-        calmode = 4;
-        if ((phCalibrationFinish == 0 && phenterCalibrationFlag == 0) && (ecCalibrationFinish == 0 && ecenterCalibrationFlag == 0) && (lightonset == 0 && lightoffset == 0)){
-        Serial.println(">>>NUTRIENT PUMP: Enter the on time (in milliseconds)<<<");
-        while (!Serial.available()) {}
-        nparsedOnTime = Serial.parseInt();
-        if (nparsedOnTime != 0){
-            if (nparsedOnTime>= 0 || nparsedOnTime == 0){
-                
-                Serial.print(">>>NUTRIENT PUMP: Nutrient pump on duration of ");
-                Serial.print(nparsedOnTime);
-                Serial.println(" is set successfully.<<<");
-                nonTime = nparsedOnTime;
-                nonmode = 1;
-            }
-            else{
-                Serial.println(">>>NUTRIENT PUMP: Invalid input. Pump on duration setup exited.<<<");
-                nonmode = 0;
-            }
+
+    case ACT_PUMP_ON:
+        printlnMessage(MSG_PUMP_ON_PROMPT);
+        parsedTime = cmdParseInt();
+        if (parsedTime > 0)
+        {
+            printMessage(MSG_PUMP_ON_DURATION);
+            this->_cmdStream->print(parsedTime);
+            printlnMessage(MSG_PUMP_SET_SUCCESS);
+            nonTime = parsedTime;
+            nonmode = 1;
         }
-        else{
-            Serial.println(">>>NUTRIENT PUMP: Invalid input. Pump on duration setup exited.<<<");
+        else
+        {
+            printlnMessage(MSG_PUMP_ON_INVALID);
+            this->_cmdFailed = true;
             nonmode = 0;
-            calmode = 0;
         }
         ncustomBlink = false;
-        }  
-        else { //when "ENTEREC" is prompted
-            calmode = 0; //back to uncalibrated mode
-            phenterCalibrationFlag = 0;
-            phCalibrationFinish = 0;
-            ecCalibrationFinish = 0;
-            ecenterCalibrationFlag = 0;
-            pumponset = 0;
-            pumponsetfinish = 0;
-            pumpoffsetfinish = 0;
-            pumpoffset = 0;
-            lightonset = 0;
-            lightonsetfinish = 0;
-            lightoffset = 0;
-            lightoffsetfinish = 0;
-            Serial.println(F(">>>Multiple command detected.<<<"));
-        } 
         break;
 
-    case 11:
-        pumpoffset = 1;
-        pumpoffsetfinish = 0;
-        calmode = 4;
-        if ((phCalibrationFinish == 0 && phenterCalibrationFlag == 0) && (ecCalibrationFinish == 0 && ecenterCalibrationFlag == 0) && (lightonset == 0 && lightoffset == 0)){
-            Serial.println("NUTRIENT PUMP: Enter the off time (in milliseconds): ");
-            while (!Serial.available()) {}
-            nparsedOffTime = Serial.parseInt();
-            if (nparsedOffTime != 0){
-                if (nparsedOffTime>= 0){
-                    Serial.print(">>>NUTRIENT PUMP: Nutrient pump off duration of ");
-                    Serial.print(nparsedOffTime);
-                    Serial.println(" is set successfully.<<<");
-                    noffTime = nparsedOffTime;
-                    noffmode = 1;
-                }
-                else{
-                    Serial.println(">>>NUTRIENT PUMP: Invalid input. Nutrient pump off duration setup exited without data saved.<<<");
-                    noffmode = 0;
-                }
-            }
-            else{
-                Serial.println(">>>NUTRIENT PUMP: Invalid input. Nutrient pump off duration setup exited without data saved.<<<");
-                noffmode = 0;
-            }
-            ncustomBlink = false;
-            }
-            else { //when "ENTEREC" is prompted
-            calmode = 0; //back to uncalibrated mode
-            phenterCalibrationFlag = 0;
-            phCalibrationFinish = 0;
-            ecCalibrationFinish = 0;
-            ecenterCalibrationFlag = 0;
-            pumponset = 0;
-            pumponsetfinish = 0;
-            pumpoffsetfinish = 0;
-            pumpoffset = 0;
-            lightonset = 0;
-            lightonsetfinish = 0;
-            lightoffset = 0;
-            lightoffsetfinish = 0;
-            Serial.println(F(">>>Multiple command detected.<<<"));
-            } 
-        break;
-    
-    case 12:
-      if (nonmode == 1 and noffmode ==1 && calmode == 4){
-        Serial.println(">>>Nutrient pump on and off duration are set successfully.<<<");
-        Serial.println(">>>Nutrient pump setup exited successfully.<<<");
-        nonmode = 0;
-        noffmode = 0;
-        calmode = 0;
-        pumponset = 0;
-        pumponsetfinish = 1;
-        pumpoffset = 0;
-        pumpoffsetfinish = 1;
-        ncustomBlink = true;
-      }
-      else {
-        if (calmode == 4){
-        Serial.println(">>>Nutrient pump setup exited unsuccessfully. Reset to zero.<<<");
+    case ACT_PUMP_OFF:
+        printlnMessage(MSG_PUMP_OFF_PROMPT);
+        parsedTime = cmdParseInt();
+        if (parsedTime > 0)
+        {
+            printMessage(MSG_PUMP_OFF_DURATION);
+            this->_cmdStream->print(parsedTime);
+            printlnMessage(MSG_PUMP_SET_SUCCESS);
+            noffTime = parsedTime;
+            noffmode = 1;
+        }
+        else
+        {
+            printlnMessage(MSG_PUMP_OFF_INVALID);
+            this->_cmdFailed = true;
+            noffmode = 0;
+        }
         ncustomBlink = false;
-        nonmode = 0;
-        noffmode = 0;
-        calmode = 0;
-        pumponset = 0;
-        pumponsetfinish = 1;
-        pumpoffset = 0;
-        pumpoffsetfinish = 1;
-        }
-        else {
-            Serial.println(">>>Wrong EXIT command detected.<<<");
-            calmode = 0;
-        }
-      }
         break;
-    }   
+
+    case ACT_PUMP_EXIT:
+        if (nonmode == 1 && noffmode == 1)
+        {
+            printlnMessage(MSG_PUMP_SETUP_DONE);
+            printlnMessage(MSG_PUMP_SETUP_EXITED);
+            ncustomBlink = true;
+        }
+        else
+        {
+            printlnMessage(MSG_PUMP_SETUP_FAILED);
+            this->_cmdFailed = true;
+            ncustomBlink = false;
+        }
+        resetCalibrationSession();
+        break;
+    }
+}
+
+void DFRobot_ESP_EC_PH::printMessage(byte id)
+{
+#ifdef ECPH_MESSAGE_CODES
+    this->_cmdStream->print('#');
+    this->_cmdStream->print(id);
+    this->_cmdStream->print(' ');
+#else
+    if (id < ECPH_MESSAGE_COUNT)
+    {
+        this->_cmdStream->print(messageText[id]);
+    }
+#endif
+}
+
+void DFRobot_ESP_EC_PH::printlnMessage(byte id)
+{
+#ifdef ECPH_MESSAGE_CODES
+    this->_cmdStream->print('#');
+    this->_cmdStream->println(id);
+#else
+    printMessage(id);
+    this->_cmdStream->println();
+#endif
 }
 
 int DFRobot_ESP_EC_PH::isCalibrated()
 {
     int calibrated;
-    if (this->_phcalibrated && this->_eccalibrated)
+    boolean phcalibrated = phCalibrated();
+    boolean eccalibrated = ecCalibrated();
+    if (phcalibrated && eccalibrated)
     {
         calibrated = 0; //ph and ec are calibrated
     } 
-    else if (!this->_phcalibrated && this->_eccalibrated)
+    else if (!phcalibrated && eccalibrated)
     {
         calibrated = 1; //ph not calibrated, ec calibrated
     }
-    else if (this->_phcalibrated && !this->_eccalibrated)
+    else if (phcalibrated && !eccalibrated)
     {
         calibrated = 2; //ph calibrated, ec not calibrated
     }
@@ -847,4 +1268,329 @@ int DFRobot_ESP_EC_PH::pumpgetOffTime() {
 
 bool DFRobot_ESP_EC_PH::ispumpSet() {
   return ncustomBlink;
-}
\ No newline at end of file
+}
+
+void DFRobot_ESP_EC_PH::trackSample(SampleTrack &track, float value, float stableRate, float stableStddev, float abruptStep)
+{
+    unsigned long now = this->_clock();
+    if (!track.primed)
+    {
+        track.last = value;
+        track.mean = value;
+        track.variance = 0.0;
+        track.time = now;
+        track.primed = true;
+        track.stable = false;
+        track.fresh = false;
+        this->_lastSampleTime = now;
+        return;
+    }
+
+    float step = fabs(value - track.last);
+    unsigned long elapsed = (uint32_t)(now - track.time); //wrap safe
+    float rate = (elapsed > 0) ? step * 1000.0 / elapsed : 0.0;
+    float deviation = value - track.mean;
+    track.mean += deviation / 8.0;                                   //EWMA, alpha = 1/8
+    track.variance += (deviation * deviation - track.variance) / 8.0;
+    track.last = value;
+    track.time = now;
+    this->_lastSampleTime = now;
+
+    if (step > abruptStep)
+    {
+        resetSampleInterval(); //abrupt change, back to the fast rate
+        return;
+    }
+    track.stable = (rate < stableRate) && (track.variance < stableStddev * stableStddev);
+    track.fresh = true;
+    if (!track.stable)
+    {
+        this->_sampleInterval = this->_sampleIntervalMin;
+        return;
+    }
+    //channels never read do not hold the interval back, the others need a new stable reading,
+    //so a cycle of readEC() + readPH() backs off once by 1.5x up to the slow limit
+    if ((!this->_ecTrack.primed || (this->_ecTrack.stable && this->_ecTrack.fresh)) &&
+        (!this->_phTrack.primed || (this->_phTrack.stable && this->_phTrack.fresh)))
+    {
+        this->_ecTrack.fresh = false;
+        this->_phTrack.fresh = false;
+        this->_sampleInterval += this->_sampleInterval / 2;
+        if (this->_sampleInterval > this->_sampleIntervalMax)
+        {
+            this->_sampleInterval = this->_sampleIntervalMax;
+        }
+    }
+}
+
+void DFRobot_ESP_EC_PH::setClock(ECPHClock clock)
+{
+    //elapsed times are 32 bit unsigned differences like millis(), so they survive the 49.7 day wrap
+    //even where unsigned long is 64 bit (host builds)
+    this->_clock = (clock != NULL) ? clock : millis;
+    this->_lastSampleTime = this->_clock() - this->_sampleInterval; //timestamps of the old clock mean nothing here
+}
+
+unsigned long DFRobot_ESP_EC_PH::nextSampleDue()
+{
+    return (uint32_t)(this->_lastSampleTime + this->_sampleInterval);
+}
+
+unsigned long DFRobot_ESP_EC_PH::sampleInterval()
+{
+    return this->_sampleInterval;
+}
+
+bool DFRobot_ESP_EC_PH::isSampleDue()
+{
+    return (uint32_t)(this->_clock() - this->_lastSampleTime) >= this->_sampleInterval; //wrap safe
+}
+
+void DFRobot_ESP_EC_PH::setSampleIntervalLimits(unsigned long minInterval, unsigned long maxInterval)
+{
+    if (minInterval == 0)
+    {
+        minInterval = 1;
+    }
+    if (maxInterval < minInterval)
+    {
+        maxInterval = minInterval;
+    }
+    this->_sampleIntervalMin = minInterval;
+    this->_sampleIntervalMax = maxInterval;
+    resetSampleInterval();
+}
+
+void DFRobot_ESP_EC_PH::resetSampleInterval()
+{
+    this->_sampleInterval = this->_sampleIntervalMin;
+    this->_ecTrack.stable = false;
+    this->_phTrack.stable = false;
+}
+
+//----- Status snapshot -----
+//heap free writers shared by the JSON and CBOR encoders
+struct ECPHStatusWriter
+{
+    uint8_t *buffer;
+    size_t length;
+    size_t pos;
+    bool cbor;
+    bool overflow;
+};
+
+static void statusPut(ECPHStatusWriter &w, const void *data, size_t n)
+{
+    if (w.overflow || w.pos + n > w.length)
+    {
+        w.overflow = true;
+        return;
+    }
+    memcpy(w.buffer + w.pos, data, n);
+    w.pos += n;
+}
+
+static void statusPutByte(ECPHStatusWriter &w, uint8_t b)
+{
+    statusPut(w, &b, 1);
+}
+
+static void cborHead(ECPHStatusWriter &w, uint8_t major, uint32_t value)
+{
+    major <<= 5;
+    if (value < 24)
+    {
+        statusPutByte(w, major | value);
+    }
+    else if (value <= 0xFF)
+    {
+        statusPutByte(w, major | 24);
+        statusPutByte(w, value);
+    }
+    else if (value <= 0xFFFF)
+    {
+        statusPutByte(w, major | 25);
+        statusPutByte(w, value >> 8);
+        statusPutByte(w, value);
+    }
+    else
+    {
+        statusPutByte(w, major | 26);
+        statusPutByte(w, value >> 24);
+        statusPutByte(w, value >> 16);
+        statusPutByte(w, value >> 8);
+        statusPutByte(w, value);
+    }
+}
+
+//decimal text without printf
+static void statusDigits(ECPHStatusWriter &w, unsigned long value)
+{
+    char text[20]; //2^64
+    int n = 0;
+    do
+    {
+        text[sizeof(text) - 1 - n++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0 && n < (int)sizeof(text));
+    statusPut(w, text + sizeof(text) - n, n);
+}
+
+static void statusKey(ECPHStatusWriter &w, const char *key)
+{
+    size_t n = strlen(key);
+    if (w.cbor)
+    {
+        cborHead(w, 3, n); //text string
+        statusPut(w, key, n);
+    }
+    else
+    {
+        if (w.pos > 1)
+        {
+            statusPutByte(w, ',');
+        }
+        statusPutByte(w, '"');
+        statusPut(w, key, n);
+        statusPut(w, "\":", 2);
+    }
+}
+
+static void statusFloat(ECPHStatusWriter &w, const char *key, float value)
+{
+    statusKey(w, key);
+    if (w.cbor)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        statusPutByte(w, 0xFA); //single precision float
+        statusPutByte(w, bits >> 24);
+        statusPutByte(w, bits >> 16);
+        statusPutByte(w, bits >> 8);
+        statusPutByte(w, bits);
+    }
+    else if (isnan(value) || isinf(value) || fabsf(value) >= STATUS_JSON_FLOAT_LIMIT)
+    {
+        statusPut(w, "null", 4);
+    }
+    else
+    {
+        //fixed point with STATUS_JSON_DECIMALS digits, printf's float path allocates on newlib
+        uint32_t scaled = (uint32_t)(fabs((double)value) * STATUS_JSON_SCALE + 0.5);
+        uint32_t fraction = scaled % STATUS_JSON_SCALE;
+        if (value < 0 && scaled > 0)
+        {
+            statusPutByte(w, '-');
+        }
+        statusDigits(w, scaled / STATUS_JSON_SCALE);
+        if (fraction > 0)
+        {
+            char text[STATUS_JSON_DECIMALS + 1];
+            text[0] = '.';
+            for (int i = STATUS_JSON_DECIMALS; i > 0; i--)
+            {
+                text[i] = '0' + fraction % 10;
+                fraction /= 10;
+            }
+            int n = STATUS_JSON_DECIMALS + 1;
+            while (text[n - 1] == '0')
+            {
+                n--; //trailing zeros
+            }
+            statusPut(w, text, n);
+        }
+    }
+}
+
+static void statusInt(ECPHStatusWriter &w, const char *key, long value)
+{
+    statusKey(w, key);
+    if (w.cbor)
+    {
+        if (value < 0)
+        {
+            cborHead(w, 1, (uint32_t)(-1 - value)); //negative integer
+        }
+        else
+        {
+            cborHead(w, 0, (uint32_t)value); //unsigned integer
+        }
+    }
+    else
+    {
+        if (value < 0)
+        {
+            statusPutByte(w, '-');
+        }
+        statusDigits(w, (value < 0) ? 0UL - (unsigned long)value : (unsigned long)value);
+    }
+}
+
+static void statusBool(ECPHStatusWriter &w, const char *key, bool value)
+{
+    statusKey(w, key);
+    if (w.cbor)
+    {
+        statusPutByte(w, value ? 0xF5 : 0xF4);
+    }
+    else if (value)
+    {
+        statusPut(w, "true", 4);
+    }
+    else
+    {
+        statusPut(w, "false", 5);
+    }
+}
+
+size_t DFRobot_ESP_EC_PH::writeStatus(ECPHStatusWriter &w)
+{
+    statusPutByte(w, w.cbor ? 0xBF : '{'); //CBOR indefinite length map
+    statusFloat(w, "ec", this->_ecvalue);
+    statusFloat(w, "ph", this->_phValue);
+    statusFloat(w, "ecVoltage", this->_ecvoltage);
+    statusFloat(w, "phVoltage", this->_phvoltage);
+    statusFloat(w, "temperature", this->_temperature);
+    statusFloat(w, "kvalue", this->_kvalue);
+    statusFloat(w, "kvalueLow", this->_kvalueLow);
+    statusFloat(w, "kvalueHigh", this->_kvalueHigh);
+    statusFloat(w, "neutralVoltage", this->_neutralVoltage);
+    statusFloat(w, "acidVoltage", this->_acidVoltage);
+    statusFloat(w, "phCalTemperature", this->_phCalTemperature);
+    statusBool(w, "ecCalibrated", ecCalibrated());
+    statusBool(w, "phCalibrated", phCalibrated());
+    statusInt(w, "calmode", getCalibrationMode());
+    statusInt(w, "lightOnTime", this->onTime);
+    statusInt(w, "lightOffTime", this->offTime);
+    statusInt(w, "pumpOnTime", this->nonTime);
+    statusInt(w, "pumpOffTime", this->noffTime);
+    statusBool(w, "pumpSet", this->ncustomBlink);
+    statusBool(w, "dosing", this->customBlink);
+    statusInt(w, "sampleInterval", (long)this->_sampleInterval);
+    statusPutByte(w, w.cbor ? 0xFF : '}');
+    if (!w.cbor)
+    {
+        statusPutByte(w, '\0');
+    }
+    if (w.overflow)
+    {
+        if (!w.cbor && w.length > 0)
+        {
+            w.buffer[0] = '\0';
+        }
+        return 0;
+    }
+    return w.cbor ? w.pos : w.pos - 1; //JSON length excludes the terminator
+}
+
+size_t DFRobot_ESP_EC_PH::statusJSON(char *buffer, size_t length)
+{
+    ECPHStatusWriter w = {(uint8_t *)buffer, length, 0, false, false};
+    return writeStatus(w);
+}
+
+size_t DFRobot_ESP_EC_PH::statusCBOR(uint8_t *buffer, size_t length)
+{
+    ECPHStatusWriter w = {buffer, length, 0, true, false};
+    return writeStatus(w);
+}
@@ -23,44 +23,103 @@
 #define _DFROBOT_ESP_EC_PH_H_
 
 #include "Arduino.h"
+#include "DFRobot_ESP_EC_PH_Core.h"
+#include "DFRobot_ESP_EC_PH_Messages.h"
+#include "DFRobot_ESP_EC_PH_ADC.h"
 
 #define KVALUEADDR 10 //the start address of the K value stored in the EEPROM
-#define RAWEC_1413_LOW 0.70
-#define RAWEC_1413_HIGH 1.80
-#define RAWEC_276_LOW 1.95
-#define RAWEC_276_HIGH 3.2
-#define RAWEC_1288_LOW 8
-#define RAWEC_1288_HIGH 16.8
 
 #define ReceivedBufferLength 10 //length of the Serial CMD buffer
 
 #define PHVALUEADDR 0 //the start address of the pH calibration parameters stored in the EEPROM
+#define PHTEMPVALUEADDR -1 //the pH calibration temperature is stored right after the K values unless begin() gets an address
+
+//bits of getCalibrationDefaults(): calibration values still at the defaults begin() had to use,
+//a bit clears once a calibration session saves that value, until then it is saved blank
+#define ECPH_DEFAULT_KVALUE_LOW 0x01
+#define ECPH_DEFAULT_KVALUE_HIGH 0x02
+#define ECPH_DEFAULT_NEUTRAL_VOLTAGE 0x04
+#define ECPH_DEFAULT_ACID_VOLTAGE 0x08
+#define ECPH_DEFAULT_PH_CAL_TEMPERATURE 0x10
+
+#define PH_CAL_TEMPERATURE_DEFAULT 25.0 //calibration temperature assumed for buffers without a recorded one
+#define PH_CAL_TEMPERATURE_MIN 0.0      //buffer temperatures accepted by CALPH and begin(), above MIN (C)
+#define PH_CAL_TEMPERATURE_MAX 60.0     //up to and including MAX (C)
+
+#define ReceivedBufferLength 10 //length of the Serial CMD buffer
+
+#define ECPH_MAX_COMMAND_PORTS 4 //number of streams (Serial, sockets, pipes) polled for commands
+#define ECPH_PORT_RX_LENGTH 32   //bytes fetched per bulk read of a command stream
+#define ECPH_CMD_TIMEOUT 500U    //a partial command older than this is discarded, a value prompt gives up after it (ms)
+#define ECPH_BATCH_MAX_STEPS 16  //commands in one runBatch() script
 
 /**
- * first you need to define the raw voltage for your circuit
- * the raw voltage for neutral pH 7.0 and acid pH 4.0 at 25 °c
- * for the actual circuit => ESP32 + ADC (ADS1115)
-*/
+ * deferred EEPROM persistence
+ * calibration changes apply in RAM at once and are only staged in the EEPROM cache,
+ * idle() writes them to flash once no change came in for the commit delay,
+ * flush() is the durability point that commits right away.
+ * The polling calls (readEC/readPH, ECcalibration/PHcalibration, update, nutrientpump)
+ * never commit. On ESP32 begin() starts a background task that calls idle(), other
+ * targets call idle() from loop(). A command that stages values (EXITEC, EXITPH,
+ * runBatch) waits for a commit the task has in progress, one flash write at most.
+ */
+#define ECPH_COMMIT_DELAY 2000U        //quiet time before staged values are committed (ms)
+#define ECPH_COMMIT_TASK_PERIOD 100    //how often the ESP32 commit task looks for staged values (ms)
+#define ECPH_COMMIT_TASK_STACK 4096    //stack of the ESP32 commit task (bytes), EEPROM.commit() needs NVS
+#define ECPH_COMMIT_TASK_PRIORITY 1    //just above the FreeRTOS idle task
+
 /**
- * you may have to adapt voltage acid and neutral offset or directly the ranges
- * according to the signal sending by your own pH probe if you don't use the DFRobot pH sensor kit probe
- * same circuit with different probe return different voltage value for buffer4.0 or buffer 7.0
+ * adaptive sampling governor
+ * the recommended sample interval grows by 1.5x per sampling cycle while the channels
+ * in use (EC, pH or both) stay stable, and drops straight back to the fast rate
+ * after dosing or an abrupt change
  */
-#define PH_VOLTAGE_ACID_OFFSET 200
-#define PH_VOLTAGE_NEUTRAL_OFFSET 200
-#define PH_8_VOLTAGE 995  //linear culculation
-#define PH_7_AT_25 1134   //laboratory measurement with isolation circuit, PH meter V2.0 and PH probe from DFRobot kit
-#define PH_6_VOLTAGE 1250 //linear culculation
-#define PH_5_VOLTAGE 1380 //linear culculation
-#define PH_4_AT_25 1521   //laboratory measurement with isolation circuit, PH meter V2.0 and PH probe from DFRobot kit
-#define PH_3_VOLTAGE 1700 //linear culculation
-
-#define PH_VOLTAGE_NEUTRAL_LOW_LIMIT PH_8_VOLTAGE - PH_VOLTAGE_NEUTRAL_OFFSET
-#define PH_VOLTAGE_NEUTRAL_HIGH_LIMIT PH_6_VOLTAGE
-#define PH_VOLTAGE_ACID_LOW_LIMIT PH_5_VOLTAGE - PH_VOLTAGE_ACID_OFFSET
-#define PH_VOLTAGE_ACID_HIGH_LIMIT PH_3_VOLTAGE
+#define SAMPLE_INTERVAL_MIN 1000   //fast sample interval (ms)
+#define SAMPLE_INTERVAL_MAX 60000  //slowest sample interval when readings are stable (ms)
+#define EC_STABLE_RATE 0.002       //max EC rate of change considered stable (ms/cm per second)
+#define EC_STABLE_STDDEV 0.02      //max EC standard deviation considered stable (ms/cm)
+#define EC_ABRUPT_STEP 0.2         //EC step between two samples treated as an abrupt change (ms/cm)
+#define PH_STABLE_RATE 0.001       //max pH rate of change considered stable (pH per second)
+#define PH_STABLE_STDDEV 0.02      //max pH standard deviation considered stable
+#define PH_ABRUPT_STEP 0.2         //pH step between two samples treated as an abrupt change
 
-#define ReceivedBufferLength 10 //length of the Serial CMD buffer
+#define STATUS_JSON_MAX_LENGTH 512 //buffer size that always fits the JSON status snapshot
+#define STATUS_JSON_DECIMALS 4        //decimals of the JSON floats, trailing zeros dropped
+#define STATUS_JSON_SCALE 10000UL     //10^STATUS_JSON_DECIMALS
+#define STATUS_JSON_FLOAT_LIMIT 400000.0 //JSON floats at or beyond it are written as null (the CBOR keeps them)
+#define STATUS_CBOR_MAX_LENGTH 320 //buffer size that always fits the CBOR status snapshot
+
+/**
+ * per reading quality metadata returned by readECExtended() / readPHExtended()
+ */
+#define ECPH_RANGE_NONE 0 //pH readings have a single range
+#define ECPH_RANGE_LOW 1  //EC converted with kvalueLow
+#define ECPH_RANGE_HIGH 2 //EC converted with kvalueHigh
+
+#define ECPH_READING_CALIBRATED 0x01     //both points of the probe calibrated, in this session or saved before
+#define ECPH_READING_SATURATED_LOW 0x02  //voltage at or below the bottom of the input range
+#define ECPH_READING_SATURATED_HIGH 0x04 //voltage at or above the top of the input range
+#define ECPH_READING_TEMP_CLAMPED 0x08   //temperature outside the compensation table
+
+#define ECPH_VOLTAGE_SATURATION_LOW 0.0     //input range of the probe boards (mV)
+#define ECPH_VOLTAGE_SATURATION_HIGH 3300.0
+
+#define EC_UNCERTAINTY_CALIBRATED 0.02    //relative EC uncertainty of a calibrated probe
+#define EC_UNCERTAINTY_UNCALIBRATED 0.10  //relative EC uncertainty with the default K = 1.0
+#define EC_UNCERTAINTY_PER_DEGREE 0.001   //relative error of the linear 1.85%/C compensation per C away from 25C
+#define PH_UNCERTAINTY_CALIBRATED 0.05    //pH uncertainty of a calibrated probe
+#define PH_UNCERTAINTY_UNCALIBRATED 0.30  //pH uncertainty with the typical buffer voltages
+#define PH_UNCERTAINTY_PER_DEGREE 0.0003  //residual Nernst error per C away from calibration per pH unit away from 7
+
+struct ECPHReading
+{
+    float value;       //EC (ms/cm) or pH, same as readEC() / readPH()
+    float uncertainty; //estimated +/- in the same unit
+    byte range;        //ECPH_RANGE_*
+    byte flags;        //ECPH_READING_*
+};
+
+typedef unsigned long (*ECPHClock)(); //millisecond time source, millis() by default
 
 class DFRobot_ESP_EC_PH
 {
@@ -74,23 +133,56 @@ public:
     void PHcalibration(float voltage, float temperature);
     void update();
     void nutrientpump();
-    float readPH(float voltage, float temperature);   // voltage to pH value, with temperature compensation
-    void begin(int ECEepromStartAddress = KVALUEADDR, int PHEepromStartAddress = PHVALUEADDR); //initialization
+    float readPH(float voltage, float temperature);   // voltage to pH value, with Nernst temperature compensation
+    ECPHReading readECExtended(float voltage, float temperature); // readEC() plus range, calibration, uncertainty and saturation
+    ECPHReading readPHExtended(float voltage, float temperature); // readPH() plus calibration, uncertainty and saturation
+    bool readFromSource(ECPHAdcSource &source, float temperature, float &ec, float &ph); // convert one averaged ADC block, blocks while the source converts it
+    bool addCommandPort(Stream &stream);    // accept commands from another stream (Serial is added by default)
+    bool removeCommandPort(Stream &stream);
+    // run a ';' separated calibration script as one transaction with a single EEPROM commit,
+    // a step may carry its reading in mV: "ENTEREC;CALEC=232@25;CALEC=2112@25;EXITEC".
+    // Scripts do not fit a command port line, gateways call this from sketch code and pass
+    // the stream the script came from for the result line (the first command port otherwise).
+    // False if the script was rejected, rolled back, or ran but its commit failed; the values
+    // then stay in effect and idle()/flush() retry the commit.
+    bool runBatch(const char *script);
+    bool runBatch(const char *script, Stream &reply);
+    void begin(int ECEepromStartAddress = KVALUEADDR, int PHEepromStartAddress = PHVALUEADDR, int PHTempEepromAddress = PHTEMPVALUEADDR); //initialization
+    float getPHCalibrationTemperature();
+    bool flush();                   // durability point: commit staged calibration values now, blocks for the flash write
+    void idle();                    // idle-time hook: commit staged values once quiet for the commit delay, never waits
+    bool beginCommitTask();         // ESP32: run idle() from a background task, begin() already starts it
+    bool isCommitPending();         // calibration values staged but not committed yet
+    void setCommitDelay(unsigned long delay);
+    unsigned long getBeginMicros(); // time begin() took to load the calibration (us)
+    byte getCalibrationDefaults();  // ECPH_DEFAULT_* bits of the values still at their defaults, 0 if none
     // boolean isECCalibrated();    
     // boolean isPHCalibrated();
     int isCalibrated();
+    int getCalibrationMode(); // current session: EC (1), PH (2), nutrient pump setup (4) or none (0)
     int getOnTime();
     int getOffTime();
     bool ecphcontrol();
     int pumpgetOnTime();
     int pumpgetOffTime();
     bool ispumpSet();
+    void setClock(ECPHClock clock);  // replace millis(), e.g. with a virtual clock for soak runs on the host
+    unsigned long nextSampleDue();   // clock timestamp of the next recommended sample, compare with (long)(now - due) >= 0
+    unsigned long sampleInterval();  // current recommended sample interval (ms)
+    bool isSampleDue();
+    void setSampleIntervalLimits(unsigned long minInterval, unsigned long maxInterval);
+    void resetSampleInterval();      // drop back to the fast sample rate
+    size_t statusJSON(char *buffer, size_t length);    // status snapshot as JSON, returns length or 0 if buffer too small
+    size_t statusCBOR(uint8_t *buffer, size_t length); // status snapshot as CBOR, returns length or 0 if buffer too small
 
 private:
+    friend struct ECPHTestAccess; // host tests in tests/, see tests/ecph_test_access.h
+
     float _ecvalue;
     float  _kvalue;
     float  _kvalueLow;
     float  _kvalueHigh;
+    bool   _ecRangeHigh; //last readEC() used kvalueHigh
     float  _ecvoltage;
     float  _temperature;
     float  _rawEC;
@@ -99,6 +191,8 @@ private:
     float _acidVoltage;
     float _neutralVoltage;
     float _phvoltage;
+    float _phCalTemperature; //buffer temperature recorded at CALPH
+    float _phSlope;          //pH per mV at 25C scaled to the calibration temperature
     boolean _phcalibrated;
     int onTime;
     int offTime;
@@ -114,16 +208,79 @@ private:
 
 
 
-    char _cmdReceivedBuffer[ReceivedBufferLength]; //store the Serial CMD
-    byte _cmdReceivedBufferIndex;
+    float _ecBlock[ECPH_ADC_BLOCK_SIZE]; //EC voltages of the last ADC block
+    float _phBlock[ECPH_ADC_BLOCK_SIZE]; //pH voltages of the last ADC block
+
+    struct CommandPort
+    {
+        Stream *stream;
+        char line[ReceivedBufferLength]; // command line being assembled
+        byte lineIndex;
+        char rx[ECPH_PORT_RX_LENGTH];    // bytes read in bulk, not parsed yet
+        byte rxHead;
+        byte rxCount;
+        unsigned long lastReceived;      // millis() of the last bulk read
+    };
+    CommandPort _ports[ECPH_MAX_COMMAND_PORTS];
+    byte _portCount;
+    byte _nextPort;             // round robin start for the next poll
+    CommandPort *_activePort;   // port of the command being executed
+    Stream *_cmdStream;         // replies and values of the current command go here
+
+    struct SampleTrack
+    {
+        float last;          // previous reading
+        float mean;          // running mean (EWMA)
+        float variance;      // running variance (EWMA)
+        unsigned long time;  // millis() of the previous reading
+        bool primed;         // at least one reading seen
+        bool stable;         // last reading within the stability limits
+        bool fresh;          // read since the interval last grew
+    };
+    SampleTrack _ecTrack;
+    SampleTrack _phTrack;
+    unsigned long _sampleIntervalMin;
+    unsigned long _sampleIntervalMax;
+    unsigned long _sampleInterval;
+    unsigned long _lastSampleTime;
+    ECPHClock _clock;
 
 private:
     int _eceepromStartAddress;
     int _pheepromStartAddress;
+    int _phTempEepromAddress;
+    volatile bool _eepromDirty;       // EEPROM cache holds values not committed yet
+    volatile bool _batchActive;       // inside runBatch(), commits are deferred to its end
+    volatile unsigned long _stagedTime; // clock of the last staged change, restarts the commit delay
+    unsigned long _commitDelay;
+#ifdef ESP32
+    SemaphoreHandle_t _eepromLock;    // EEPROM cache writes vs. the commit task
+    TaskHandle_t _commitTask;
+#endif
+    bool _cmdFailed;            // the last Calibration() command was rejected or failed
+    byte _calState;             // calibration state machine state, CAL_* in the .cpp
+    byte _calPoints;            // buffers calibrated in the current session
+    bool _calPointDone;         // the last CALEC/CALPH of the session succeeded
+    byte _calibrationDefaults;  // ECPH_DEFAULT_* bits, what begin() could not load and no session saved yet
+    unsigned long _beginMicros;
+    boolean ecCalibrated();     // loaded from EEPROM or calibrated in this session
+    boolean phCalibrated();
     boolean cmdSerialDataAvailable();
+    boolean pollCommandPort(CommandPort &port);
+    long cmdParseInt();
     void Calibration(byte mode); // calibration process, wirte key parameters to EEPROM
+    void calibrationAction(byte action);
+    void resetCalibrationSession();
+    void updatePHModel();
+    void stageCalibration(byte parts); // copy values to the EEPROM cache for the next commit, waits for a commit in progress
+    bool lockEEPROM(bool wait);
+    void unlockEEPROM();
     byte cmdParse(const char *cmd);
     byte cmdParse();
+    void printMessage(byte id);   // print a catalog message (text, or "#code" with ECPH_MESSAGE_CODES)
+    void printlnMessage(byte id);
+    void trackSample(SampleTrack &track, float value, float stableRate, float stableStddev, float abruptStep);
+    size_t writeStatus(struct ECPHStatusWriter &writer);
 };
 
 #endif
@@ -0,0 +1,236 @@
+/*
+ * file DFRobot_ESP_EC_PH_ADC.cpp
+ *
+ * ADC sources for the Modified DFRobot ECPH library, see DFRobot_ESP_EC_PH_ADC.h
+ */
+
+#include "DFRobot_ESP_EC_PH_ADC.h"
+
+//----- In-memory mock source -----
+
+ECPHMockAdcSource::ECPHMockAdcSource(const float *ecVoltages, const float *phVoltages, size_t length)
+{
+    this->_ecVoltages = ecVoltages;
+    this->_phVoltages = phVoltages;
+    this->_length = length;
+    this->_position = 0;
+    this->_samplesRead = 0;
+    this->_channel = ECPH_CHANNEL_EC;
+    this->_interferenceOffset = 0;
+    this->_interferenceDecay = 0;
+    this->_clock = NULL;
+    this->_ecLeftAt = 0;
+}
+
+bool ECPHMockAdcSource::begin()
+{
+    this->_position = 0;
+    this->_samplesRead = 0;
+    return this->_length > 0;
+}
+
+size_t ECPHMockAdcSource::readBlock(float *ecVoltages, float *phVoltages, size_t count)
+{
+    if (this->_length == 0)
+    {
+        return 0;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        ecVoltages[i] = this->_ecVoltages[this->_position];
+        phVoltages[i] = this->_phVoltages[this->_position];
+        if (++this->_position == this->_length)
+        {
+            this->_position = 0;
+        }
+    }
+    this->_samplesRead += count;
+    return count;
+}
+
+bool ECPHMockAdcSource::selectChannel(uint8_t channel)
+{
+    if (this->_channel == ECPH_CHANNEL_EC && channel != ECPH_CHANNEL_EC && this->_clock != NULL)
+    {
+        this->_ecLeftAt = this->_clock();
+    }
+    this->_channel = channel;
+    return true;
+}
+
+bool ECPHMockAdcSource::readSample(float &millivolts)
+{
+    if (this->_length == 0)
+    {
+        return false;
+    }
+    if (this->_channel == ECPH_CHANNEL_EC)
+    {
+        millivolts = this->_ecVoltages[this->_position];
+    }
+    else
+    {
+        millivolts = this->_phVoltages[this->_position];
+        if (this->_clock != NULL && this->_interferenceDecay > 0)
+        {
+            unsigned long since = (uint32_t)(this->_clock() - this->_ecLeftAt);
+            if (since < this->_interferenceDecay)
+            {
+                millivolts += this->_interferenceOffset * (float)(this->_interferenceDecay - since) / this->_interferenceDecay;
+            }
+        }
+    }
+    if (++this->_position == this->_length)
+    {
+        this->_position = 0;
+    }
+    this->_samplesRead++;
+    return true;
+}
+
+void ECPHMockAdcSource::setInterference(float offset, unsigned long decay, unsigned long (*clock)())
+{
+    this->_interferenceOffset = offset;
+    this->_interferenceDecay = decay;
+    this->_clock = clock;
+    this->_ecLeftAt = (clock != NULL) ? clock() - decay : 0; //no crosstalk before the first EC window
+}
+
+size_t ECPHMockAdcSource::samplesRead()
+{
+    return this->_samplesRead;
+}
+
+#ifdef ARDUINO
+//----- ADS1115 continuous conversion source -----
+
+#define ADS1115_REG_CONVERSION 0x00
+#define ADS1115_REG_CONFIG 0x01
+#define ADS1115_MUX_SINGLE_0 0x4000 //AIN0 against GND, AIN1..3 follow in steps of 0x1000
+#define ADS1115_MODE_CONTINUOUS 0x0000
+#define ADS1115_COMP_DISABLE 0x0003
+
+ECPHADS1115Source::ECPHADS1115Source(TwoWire &wire, uint8_t address, uint8_t ecChannel, uint8_t phChannel, uint16_t gain, uint16_t rate)
+{
+    this->_wire = &wire;
+    this->_address = address;
+    this->_ecChannel = ecChannel & 0x03;
+    this->_phChannel = phChannel & 0x03;
+    this->_gain = gain;
+    this->_rate = rate;
+
+    switch (rate)
+    {
+    case ADS1115_RATE_128SPS:
+        this->_conversionMicros = 7813;
+        break;
+    case ADS1115_RATE_475SPS:
+        this->_conversionMicros = 2106;
+        break;
+    default:
+        this->_conversionMicros = 1163; //860SPS
+        break;
+    }
+    switch (gain)
+    {
+    case ADS1115_GAIN_4096MV:
+        this->_millivoltsPerBit = 0.125;
+        break;
+    case ADS1115_GAIN_2048MV:
+        this->_millivoltsPerBit = 0.0625;
+        break;
+    default:
+        this->_millivoltsPerBit = 0.1875; //6.144V
+        break;
+    }
+    this->_channelStart = 0;
+    this->_lastRead = 0;
+}
+
+bool ECPHADS1115Source::begin()
+{
+    return startContinuous(this->_ecChannel);
+}
+
+bool ECPHADS1115Source::startContinuous(uint8_t channel)
+{
+    uint16_t config = (ADS1115_MUX_SINGLE_0 + ((uint16_t)channel << 12)) | this->_gain | ADS1115_MODE_CONTINUOUS | this->_rate | ADS1115_COMP_DISABLE;
+    this->_wire->beginTransmission(this->_address);
+    this->_wire->write(ADS1115_REG_CONFIG);
+    this->_wire->write((uint8_t)(config >> 8));
+    this->_wire->write((uint8_t)config);
+    if (this->_wire->endTransmission() != 0)
+    {
+        return false;
+    }
+    //leave the pointer on the conversion register so each sample is a bare 2 byte read
+    this->_wire->beginTransmission(this->_address);
+    this->_wire->write(ADS1115_REG_CONVERSION);
+    return this->_wire->endTransmission() == 0;
+}
+
+bool ECPHADS1115Source::selectChannel(uint8_t channel)
+{
+    this->_channelStart = micros();
+    this->_lastRead = this->_channelStart;
+    return startContinuous((channel == ECPH_CHANNEL_EC) ? this->_ecChannel : this->_phChannel);
+}
+
+bool ECPHADS1115Source::readSample(float &millivolts)
+{
+    unsigned long now = micros();
+    //skip the conversion that was running at the mux switch, then one read per conversion period
+    if ((uint32_t)(now - this->_channelStart) < 2 * this->_conversionMicros || (uint32_t)(now - this->_lastRead) < this->_conversionMicros)
+    {
+        return false;
+    }
+    if (this->_wire->requestFrom(this->_address, (uint8_t)2) != 2)
+    {
+        return false;
+    }
+    this->_lastRead = now;
+    uint8_t high = this->_wire->read(); //separate statements fix the byte order
+    uint8_t low = this->_wire->read();
+    millivolts = (int16_t)((high << 8) | low) * this->_millivoltsPerBit;
+    return true;
+}
+
+size_t ECPHADS1115Source::readChannel(float *voltages, size_t count)
+{
+    //the conversion running when the mux changed still belongs to the previous channel
+    delayMicroseconds(2 * this->_conversionMicros);
+    unsigned long due = micros();
+    for (size_t i = 0; i < count; i++)
+    {
+        while ((long)(micros() - due) < 0)
+        {
+        }
+        due += this->_conversionMicros;
+        if (this->_wire->requestFrom(this->_address, (uint8_t)2) != 2)
+        {
+            return i;
+        }
+        //two statements: the operands of | may be evaluated in either order
+        uint8_t high = this->_wire->read();
+        uint8_t low = this->_wire->read();
+        voltages[i] = (int16_t)((high << 8) | low) * this->_millivoltsPerBit;
+    }
+    return count;
+}
+
+size_t ECPHADS1115Source::readBlock(float *ecVoltages, float *phVoltages, size_t count)
+{
+    size_t ecCount, phCount;
+    if (!startContinuous(this->_ecChannel))
+    {
+        return 0;
+    }
+    ecCount = readChannel(ecVoltages, count);
+    if (!startContinuous(this->_phChannel))
+    {
+        return 0;
+    }
+    phCount = readChannel(phVoltages, count);
+    return (ecCount < phCount) ? ecCount : phCount;
+}
+#endif
@@ -0,0 +1,110 @@
+/*
+ * file DFRobot_ESP_EC_PH_ADC.h
+ *
+ * ADC sources for the Modified DFRobot ECPH library.
+ * A source fills blocks of EC and pH probe voltages (millivolts) that are
+ * handed to DFRobot_ESP_EC_PH::readFromSource() for conversion.
+ *
+ * ECPHADS1115Source keeps the ADS1115 in continuous conversion mode and
+ * only reads the conversion register for each sample, instead of paying a
+ * config write, a wait and a pointer write for every single-shot reading.
+ * ECPHMockAdcSource replays in-memory voltages and builds without Arduino.
+ *
+ * readBlock() blocks until the block is converted: two conversions are skipped
+ * after each mux switch, so a block takes about 2 * (count + 1) conversion periods,
+ * 40 ms for 16 samples at 860 SPS and 265 ms at 128 SPS. Loops that
+ * must not stall should use ECPHAcquisitionScheduler, which only calls the
+ * non-blocking selectChannel() / readSample().
+ */
+
+#ifndef _DFROBOT_ESP_EC_PH_ADC_H_
+#define _DFROBOT_ESP_EC_PH_ADC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ECPH_ADC_BLOCK_SIZE 16 //samples per channel converted by readFromSource()
+
+#define ECPH_CHANNEL_EC 0
+#define ECPH_CHANNEL_PH 1
+
+class ECPHAdcSource
+{
+public:
+    virtual ~ECPHAdcSource() {}
+    virtual bool begin() = 0;
+    // fill count EC and count pH voltages (millivolts), returns the number of samples per channel
+    // may block until the samples are converted, see ECPHADS1115Source
+    virtual size_t readBlock(float *ecVoltages, float *phVoltages, size_t count) = 0;
+    // non-blocking single channel access used by ECPHAcquisitionScheduler
+    virtual bool selectChannel(uint8_t channel) = 0;     // ECPH_CHANNEL_EC or ECPH_CHANNEL_PH
+    virtual bool readSample(float &millivolts) = 0;      // false until a fresh conversion is available
+};
+
+class ECPHMockAdcSource : public ECPHAdcSource
+{
+public:
+    // ec/ph voltages are replayed in order and wrap around at the end
+    ECPHMockAdcSource(const float *ecVoltages, const float *phVoltages, size_t length);
+    bool begin();
+    size_t readBlock(float *ecVoltages, float *phVoltages, size_t count);
+    bool selectChannel(uint8_t channel);
+    bool readSample(float &millivolts);
+    size_t samplesRead();
+    // model EC excitation crosstalk: pH samples read within decay ms of leaving the EC channel
+    // are shifted by offset millivolts, fading linearly to zero
+    void setInterference(float offset, unsigned long decay, unsigned long (*clock)());
+
+private:
+    const float *_ecVoltages;
+    const float *_phVoltages;
+    size_t _length;
+    size_t _position;
+    size_t _samplesRead;
+    uint8_t _channel;
+    float _interferenceOffset;
+    unsigned long _interferenceDecay;
+    unsigned long (*_clock)();
+    unsigned long _ecLeftAt;
+};
+
+#ifdef ARDUINO
+#include "Arduino.h"
+#include "Wire.h"
+
+#define ADS1115_ADDRESS 0x48
+#define ADS1115_GAIN_6144MV 0x0000 //+/-6.144V, 0.1875mV per bit
+#define ADS1115_GAIN_4096MV 0x0200 //+/-4.096V, 0.125mV per bit
+#define ADS1115_GAIN_2048MV 0x0400 //+/-2.048V, 0.0625mV per bit
+#define ADS1115_RATE_128SPS 0x0080
+#define ADS1115_RATE_475SPS 0x00C0
+#define ADS1115_RATE_860SPS 0x00E0
+
+class ECPHADS1115Source : public ECPHAdcSource
+{
+public:
+    ECPHADS1115Source(TwoWire &wire = Wire, uint8_t address = ADS1115_ADDRESS, uint8_t ecChannel = 0, uint8_t phChannel = 1,
+                      uint16_t gain = ADS1115_GAIN_6144MV, uint16_t rate = ADS1115_RATE_860SPS);
+    bool begin();
+    size_t readBlock(float *ecVoltages, float *phVoltages, size_t count);
+    bool selectChannel(uint8_t channel);
+    bool readSample(float &millivolts);
+
+private:
+    TwoWire *_wire;
+    uint8_t _address;
+    uint8_t _ecChannel;
+    uint8_t _phChannel;
+    uint16_t _gain;
+    uint16_t _rate;
+    unsigned long _conversionMicros;
+    float _millivoltsPerBit;
+    unsigned long _channelStart; //micros() of the last mux switch
+    unsigned long _lastRead;     //micros() of the last conversion read
+
+    bool startContinuous(uint8_t channel);
+    size_t readChannel(float *voltages, size_t count);
+};
+#endif
+
+#endif
@@ -0,0 +1,111 @@
+/*
+ * file DFRobot_ESP_EC_PH_Core.h
+ *
+ * Conversion core of the Modified DFRobot ECPH library: voltage to EC and pH,
+ * EC auto range and temperature compensation. Plain C++ without Arduino
+ * dependencies, shared by readEC() / readPH() and the host tools in tools/
+ * so offline reprocessing gives exactly the values the controller computes.
+ */
+
+#ifndef _DFROBOT_ESP_EC_PH_CORE_H_
+#define _DFROBOT_ESP_EC_PH_CORE_H_
+
+#include <math.h>
+
+#define RES2 820.0
+#define ECREF 200.0
+
+#define RAWEC_1413_LOW 0.70
+#define RAWEC_1413_HIGH 1.80
+#define RAWEC_276_LOW 1.95
+#define RAWEC_276_HIGH 3.2
+#define RAWEC_1288_LOW 8
+#define RAWEC_1288_HIGH 16.8
+
+#define EC_RANGE_SHIFT_UP 2.5   //switch to kvalueHigh above this uncompensated EC
+#define EC_RANGE_SHIFT_DOWN 2.0 //switch back to kvalueLow below this uncompensated EC
+
+/**
+ * first you need to define the raw voltage for your circuit
+ * the raw voltage for neutral pH 7.0 and acid pH 4.0 at 25 °c
+ * for the actual circuit => ESP32 + ADC (ADS1115)
+*/
+/**
+ * you may have to adapt voltage acid and neutral offset or directly the ranges
+ * according to the signal sending by your own pH probe if you don't use the DFRobot pH sensor kit probe
+ * same circuit with different probe return different voltage value for buffer4.0 or buffer 7.0
+ */
+#define PH_VOLTAGE_ACID_OFFSET 200
+#define PH_VOLTAGE_NEUTRAL_OFFSET 200
+#define PH_8_VOLTAGE 995  //linear culculation
+#define PH_7_AT_25 1134   //laboratory measurement with isolation circuit, PH meter V2.0 and PH probe from DFRobot kit
+#define PH_6_VOLTAGE 1250 //linear culculation
+#define PH_5_VOLTAGE 1380 //linear culculation
+#define PH_4_AT_25 1521   //laboratory measurement with isolation circuit, PH meter V2.0 and PH probe from DFRobot kit
+#define PH_3_VOLTAGE 1700 //linear culculation
+
+#define PH_VOLTAGE_NEUTRAL_LOW_LIMIT PH_8_VOLTAGE - PH_VOLTAGE_NEUTRAL_OFFSET
+#define PH_VOLTAGE_NEUTRAL_HIGH_LIMIT PH_6_VOLTAGE
+#define PH_VOLTAGE_ACID_LOW_LIMIT PH_5_VOLTAGE - PH_VOLTAGE_ACID_OFFSET
+#define PH_VOLTAGE_ACID_HIGH_LIMIT PH_3_VOLTAGE
+
+#define PH_NERNST_TABLE_MIN 0           //first temperature of the Nernst slope factor table (C)
+#define PH_NERNST_TABLE_MAX 50          //last temperature of the Nernst slope factor table (C)
+
+//Nernst slope factor 298.15K / (T + 273.15K) for T = 0..51C in 1C steps
+//the electrode mV per pH grows with absolute temperature, so pH per mV shrinks
+static const float nernstFactor[PH_NERNST_TABLE_MAX - PH_NERNST_TABLE_MIN + 2] = {
+    1.091525, 1.087543, 1.083591, 1.079667, 1.075771, 1.071904, 1.068064, 1.064251,
+    1.060466, 1.056707, 1.052975, 1.049270, 1.045590, 1.041936, 1.038308, 1.034704,
+    1.031126, 1.027572, 1.024043, 1.020537, 1.017056, 1.013599, 1.010164, 1.006753,
+    1.003365, 1.000000, 0.996657, 0.993337, 0.990038, 0.986762, 0.983507, 0.980273,
+    0.977060, 0.973869, 0.970698, 0.967548, 0.964419, 0.961309, 0.958220, 0.955150,
+    0.952100, 0.949069, 0.946057, 0.943065, 0.940091, 0.937137, 0.934200, 0.931282,
+    0.928382, 0.925501, 0.922637, 0.919790,
+};
+
+//uncompensated EC before the K value (voltage in mV)
+inline float ecphRawEC(float voltage)
+{
+    return 1000 * voltage / RES2 / ECREF;
+}
+
+//automatic shift process, First Range:(0,2); Second Range:(2,20)
+//the band between the two thresholds keeps the current range
+inline bool ecphRangeHigh(float rawEC, bool rangeHigh, float kvalueLow, float kvalueHigh)
+{
+    float valueTemp = rawEC * (rangeHigh ? kvalueHigh : kvalueLow);
+    if (valueTemp > EC_RANGE_SHIFT_UP)
+    {
+        return true;
+    }
+    if (valueTemp < EC_RANGE_SHIFT_DOWN)
+    {
+        return false;
+    }
+    return rangeHigh;
+}
+
+//EC after the K value, compensated to 25C
+inline float ecphEC(float rawEC, float kvalue, float temperature)
+{
+    return rawEC * kvalue / (1.0 + 0.0185 * (temperature - 25.0));
+}
+
+//pH per mV at 25C for the two buffer voltages, the buffers were read at calTemperature
+inline float ecphPHSlope(float neutralVoltage, float acidVoltage, float calTemperature)
+{
+    return (7.0 - 4.0) / (neutralVoltage - acidVoltage) * (calTemperature + 273.15) / 298.15;
+}
+
+//two point: (neutralVoltage,7.0),(acidVoltage,4.0), pivoting on pH 7.0
+//slope scaled by the Nernst factor, linear between the 1C table entries
+inline float ecphPH(float voltage, float temperature, float slope, float neutralVoltage)
+{
+    float t = fminf(fmaxf(temperature, PH_NERNST_TABLE_MIN), PH_NERNST_TABLE_MAX) - PH_NERNST_TABLE_MIN;
+    int index = (int)t;
+    float factor = nernstFactor[index] + (nernstFactor[index + 1] - nernstFactor[index]) * (t - index);
+    return 7.0 + slope * factor * (voltage - neutralVoltage);
+}
+
+#endif
@@ -0,0 +1,76 @@
+/*
+ * file DFRobot_ESP_EC_PH_Messages.h
+ *
+ * Message catalog for the Modified DFRobot ECPH library.
+ * Every user-facing string printed by the library lives here once.
+ *
+ * Build with ECPH_MESSAGE_CODES defined to print compact codes ("#12")
+ * instead of the text; the strings are then left out of the firmware.
+ * Expand a captured log back to text on the host with tools/ecph_msgdecode.cpp
+ *
+ * Codes are the position in the list: only append new messages at the end
+ * so logs captured with older firmware still decode.
+ */
+
+#ifndef _DFROBOT_ESP_EC_PH_MESSAGES_H_
+#define _DFROBOT_ESP_EC_PH_MESSAGES_H_
+
+#define ECPH_MESSAGE_LIST(X) \
+    X(MSG_END, "<<<") \
+    X(MSG_MUL, " * ") \
+    X(MSG_DIV_1000, " / 1000.0 / ") \
+    X(MSG_COMMAND_ERROR, ">>>Command Error<<<") \
+    X(MSG_EC_ENTER, ">>>Enter EC Calibration Mode<<<") \
+    X(MSG_EC_PROBE_HINT, ">>>Please put the probe into the 1413us/cm or 2.76ms/cm or 12.88ms/cm buffer solution<<<") \
+    X(MSG_EC_TWO_POINT_HINT, ">>>Only need two point for calibration one low (1413us/com) and one high(2.76ms/cm or 12.88ms/cm)<<<") \
+    X(MSG_MULTIPLE_CALIBRATION, ">>>Multiple calibration command detected.<<<") \
+    X(MSG_MULTIPLE_COMMAND, ">>>Multiple command detected.<<<") \
+    X(MSG_EC_BUFFER_1413, ">>>Buffer 1.413ms/cm<<<") \
+    X(MSG_EC_BUFFER_276, ">>>Buffer 2.76ms/cm<<<") \
+    X(MSG_EC_BUFFER_1288, ">>>Buffer 12.88ms/cm<<<") \
+    X(MSG_COMP_EC_SOLUTION, ">>>compECsolution: ") \
+    X(MSG_BUFFER_ERROR, ">>>Buffer Solution Error Try Again<<<") \
+    X(MSG_KVALUE_FORMULA, ">>>KValueTemp calculation formule: RES2 * ECREF * compECsolution / 1000.0 / voltage<<<") \
+    X(MSG_KVALUE_CALCULATION, ">>>KValueTemp calculation: ") \
+    X(MSG_KVALUE_TEMP, ">>>KValueTemp: ") \
+    X(MSG_EC_SUCCESS_K, ">>>Successful,K:") \
+    X(MSG_EC_SEND_EXIT, ", Send EXITEC to Save and Exit<<<") \
+    X(MSG_KVALUE_HIGH, ">>>kvalueHigh: ") \
+    X(MSG_KVALUE_OUT_OF_RANGE, ">>>KValueTemp out of range 0.5-2.0<<<") \
+    X(MSG_FAILED_TRY_AGAIN, ">>>Failed,Try Again<<<") \
+    X(MSG_WRONG_CAL, ">>Wrong CAL command detected.<<<") \
+    X(MSG_WRONG_EXIT, ">>>Wrong EXIT command detected.<<<") \
+    X(MSG_CAL_SUCCESSFUL, ">>>Calibration Successful") \
+    X(MSG_CAL_FAILED, ">>>Calibration Failed") \
+    X(MSG_EC_EXIT, ",Exit EC Calibration Mode<<<") \
+    X(MSG_PH_EXIT, ",Exit PH Calibration Mode<<<") \
+    X(MSG_PH_ENTER, ">>>Enter PH Calibration Mode<<<") \
+    X(MSG_PH_PROBE_HINT, ">>>Please put the probe into the 4.0 or 7.0 standard buffer solution<<<") \
+    X(MSG_PH_BUFFER_7, ">>>Buffer Solution:7.0") \
+    X(MSG_PH_BUFFER_4, ">>>Buffer Solution:4.0") \
+    X(MSG_PH_SEND_EXIT, ",Send EXITPH to Save and Exit<<<") \
+    X(MSG_PUMP_ON_PROMPT, ">>>NUTRIENT PUMP: Enter the on time (in milliseconds)<<<") \
+    X(MSG_PUMP_ON_DURATION, ">>>NUTRIENT PUMP: Nutrient pump on duration of ") \
+    X(MSG_PUMP_SET_SUCCESS, " is set successfully.<<<") \
+    X(MSG_PUMP_ON_INVALID, ">>>NUTRIENT PUMP: Invalid input. Pump on duration setup exited.<<<") \
+    X(MSG_PUMP_OFF_PROMPT, "NUTRIENT PUMP: Enter the off time (in milliseconds): ") \
+    X(MSG_PUMP_OFF_DURATION, ">>>NUTRIENT PUMP: Nutrient pump off duration of ") \
+    X(MSG_PUMP_OFF_INVALID, ">>>NUTRIENT PUMP: Invalid input. Nutrient pump off duration setup exited without data saved.<<<") \
+    X(MSG_PUMP_SETUP_DONE, ">>>Nutrient pump on and off duration are set successfully.<<<") \
+    X(MSG_PUMP_SETUP_EXITED, ">>>Nutrient pump setup exited successfully.<<<") \
+    X(MSG_PUMP_SETUP_FAILED, ">>>Nutrient pump setup exited unsuccessfully. Reset to zero.<<<") \
+    X(MSG_BATCH_OK, ">>>Batch executed and saved, steps: ") \
+    X(MSG_BATCH_INVALID, ">>>Batch rejected, nothing changed. Invalid step: ") \
+    X(MSG_BATCH_ROLLED_BACK, ">>>Batch failed and rolled back. Failed step: ") \
+    X(MSG_BATCH_NOT_SAVED, ">>>Batch executed but the EEPROM commit failed, retrying. Steps: ") \
+    X(MSG_PH_TEMPERATURE_ERROR, ">>>Buffer temperature out of range, check the temperature sensor and try again<<<")
+
+enum ECPHMessage
+{
+#define ECPH_MESSAGE_ID(id, text) id,
+    ECPH_MESSAGE_LIST(ECPH_MESSAGE_ID)
+#undef ECPH_MESSAGE_ID
+    ECPH_MESSAGE_COUNT
+};
+
+#endif
@@ -0,0 +1,176 @@
+/*
+ * file DFRobot_ESP_EC_PH_Scheduler.cpp
+ *
+ * Time multiplexed EC/pH acquisition, see DFRobot_ESP_EC_PH_Scheduler.h
+ */
+
+#include "DFRobot_ESP_EC_PH_Scheduler.h"
+
+#define PHASE_EC_SETTLE 0
+#define PHASE_EC_SAMPLE 1
+#define PHASE_PH_BLANKING 2
+#define PHASE_PH_SAMPLE 3
+
+ECPHAcquisitionScheduler::ECPHAcquisitionScheduler(DFRobot_ESP_EC_PH &meter, ECPHAdcSource &source)
+{
+    this->_meter = &meter;
+    this->_source = &source;
+    this->_clock = millis;
+    this->_ecSettle = ECPH_SCHED_EC_SETTLE;
+    this->_ecWindow = ECPH_SCHED_EC_WINDOW;
+    this->_blanking = ECPH_SCHED_BLANKING;
+    this->_phWindow = ECPH_SCHED_PH_WINDOW;
+    this->_phase = PHASE_EC_SETTLE;
+    this->_phaseStart = 0;
+    this->_sum = 0;
+    this->_count = 0;
+    this->_ec = 0;
+    this->_ph = 7.0;
+    this->_ecFresh = false;
+    this->_phFresh = false;
+    this->_rateStart = 0;
+    this->_ecRateCount = 0;
+    this->_phRateCount = 0;
+    this->_ecRate = 0;
+    this->_phRate = 0;
+}
+
+void ECPHAcquisitionScheduler::begin()
+{
+    unsigned long now = this->_clock();
+    this->_rateStart = now;
+    this->_ecRateCount = 0;
+    this->_phRateCount = 0;
+    enterPhase(PHASE_EC_SETTLE, now);
+}
+
+void ECPHAcquisitionScheduler::setTiming(unsigned long ecSettle, unsigned long ecWindow, unsigned long blanking, unsigned long phWindow)
+{
+    this->_ecSettle = ecSettle;
+    this->_ecWindow = (ecWindow > 0) ? ecWindow : 1;
+    this->_blanking = blanking;
+    this->_phWindow = (phWindow > 0) ? phWindow : 1;
+}
+
+void ECPHAcquisitionScheduler::setClock(ECPHClock clock)
+{
+    this->_clock = (clock != NULL) ? clock : millis;
+}
+
+void ECPHAcquisitionScheduler::enterPhase(byte phase, unsigned long now)
+{
+    if (phase == PHASE_EC_SETTLE)
+    {
+        this->_source->selectChannel(ECPH_CHANNEL_EC);
+    }
+    else if (phase == PHASE_PH_BLANKING)
+    {
+        this->_source->selectChannel(ECPH_CHANNEL_PH);
+    }
+    this->_phase = phase;
+    this->_phaseStart = now;
+    this->_sum = 0;
+    this->_count = 0;
+}
+
+void ECPHAcquisitionScheduler::poll(float temperature)
+{
+    unsigned long now = this->_clock();
+    unsigned long elapsed = (uint32_t)(now - this->_phaseStart);
+    float millivolts;
+
+    switch (this->_phase)
+    {
+    case PHASE_EC_SETTLE:
+        if (elapsed >= this->_ecSettle)
+        {
+            enterPhase(PHASE_EC_SAMPLE, now);
+        }
+        break;
+
+    case PHASE_EC_SAMPLE:
+        if (elapsed >= this->_ecWindow)
+        {
+            if (this->_count > 0)
+            {
+                this->_ec = this->_meter->readEC(this->_sum / this->_count, temperature);
+                this->_ecFresh = true;
+            }
+            enterPhase(PHASE_PH_BLANKING, now);
+        }
+        else if (this->_source->readSample(millivolts))
+        {
+            this->_sum += millivolts;
+            this->_count++;
+            this->_ecRateCount++;
+        }
+        break;
+
+    case PHASE_PH_BLANKING:
+        if (elapsed >= this->_blanking)
+        {
+            enterPhase(PHASE_PH_SAMPLE, now);
+        }
+        break;
+
+    case PHASE_PH_SAMPLE:
+        if (elapsed >= this->_phWindow)
+        {
+            if (this->_count > 0)
+            {
+                this->_ph = this->_meter->readPH(this->_sum / this->_count, temperature);
+                this->_phFresh = true;
+            }
+            enterPhase(PHASE_EC_SETTLE, now);
+        }
+        else if (this->_source->readSample(millivolts))
+        {
+            this->_sum += millivolts;
+            this->_count++;
+            this->_phRateCount++;
+        }
+        break;
+    }
+
+    unsigned long ratePeriod = (uint32_t)(now - this->_rateStart);
+    if (ratePeriod >= ECPH_SCHED_RATE_PERIOD)
+    {
+        this->_ecRate = this->_ecRateCount * 1000.0 / ratePeriod;
+        this->_phRate = this->_phRateCount * 1000.0 / ratePeriod;
+        this->_ecRateCount = 0;
+        this->_phRateCount = 0;
+        this->_rateStart = now;
+    }
+}
+
+bool ECPHAcquisitionScheduler::hasEC()
+{
+    return this->_ecFresh;
+}
+
+bool ECPHAcquisitionScheduler::hasPH()
+{
+    return this->_phFresh;
+}
+
+float ECPHAcquisitionScheduler::ec()
+{
+    this->_ecFresh = false;
+    return this->_ec;
+}
+
+float ECPHAcquisitionScheduler::ph()
+{
+    this->_phFresh = false;
+    return this->_ph;
+}
+
+float ECPHAcquisitionScheduler::ecSamplesPerSecond()
+{
+    return this->_ecRate;
+}
+
+float ECPHAcquisitionScheduler::phSamplesPerSecond()
+{
+    return this->_phRate;
+}
@@ -0,0 +1,70 @@
+/*
+ * file DFRobot_ESP_EC_PH_Scheduler.h
+ *
+ * Time multiplexed EC/pH acquisition for the Modified DFRobot ECPH library.
+ * The EC excitation disturbs the pH electrode when both probes share a reservoir,
+ * so the scheduler alternates measurement windows without blocking:
+ *
+ *   select EC | settle | EC window | select pH | blanking | pH window | select EC ...
+ *
+ * Call poll() from loop() as often as possible; it takes at most one sample per
+ * call and converts the window average through readEC() / readPH() when a window closes.
+ */
+
+#ifndef _DFROBOT_ESP_EC_PH_SCHEDULER_H_
+#define _DFROBOT_ESP_EC_PH_SCHEDULER_H_
+
+#include "DFRobot_ESP_EC_PH.h"
+#include "DFRobot_ESP_EC_PH_ADC.h"
+
+#define ECPH_SCHED_EC_SETTLE 20    //ms after selecting the EC channel before its samples are valid
+#define ECPH_SCHED_EC_WINDOW 100   //ms of EC sampling per cycle
+#define ECPH_SCHED_BLANKING 250    //ms after the EC window before pH samples are free of crosstalk
+#define ECPH_SCHED_PH_WINDOW 200   //ms of pH sampling per cycle
+#define ECPH_SCHED_RATE_PERIOD 1000 //ms over which samples/sec are measured
+
+class ECPHAcquisitionScheduler
+{
+public:
+    ECPHAcquisitionScheduler(DFRobot_ESP_EC_PH &meter, ECPHAdcSource &source);
+    void begin();
+    void setTiming(unsigned long ecSettle, unsigned long ecWindow, unsigned long blanking, unsigned long phWindow);
+    void setClock(ECPHClock clock);
+    void poll(float temperature);
+
+    bool hasEC();          // a new EC value arrived since the last ec() call
+    bool hasPH();          // a new pH value arrived since the last ph() call
+    float ec();
+    float ph();
+    float ecSamplesPerSecond(); // valid samples taken in the EC windows, last rate period
+    float phSamplesPerSecond();
+
+private:
+    DFRobot_ESP_EC_PH *_meter;
+    ECPHAdcSource *_source;
+    ECPHClock _clock;
+    unsigned long _ecSettle;
+    unsigned long _ecWindow;
+    unsigned long _blanking;
+    unsigned long _phWindow;
+
+    byte _phase;
+    unsigned long _phaseStart;
+    float _sum;                  //samples of the open window
+    unsigned int _count;
+
+    float _ec;
+    float _ph;
+    bool _ecFresh;
+    bool _phFresh;
+
+    unsigned long _rateStart;
+    unsigned long _ecRateCount;
+    unsigned long _phRateCount;
+    float _ecRate;
+    float _phRate;
+
+    void enterPhase(byte phase, unsigned long now);
+};
+
+#endif
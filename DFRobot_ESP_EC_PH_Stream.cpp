@@ -0,0 +1,112 @@
+/*
+ * file DFRobot_ESP_EC_PH_Stream.cpp
+ *
+ * In-memory command stream for the Modified DFRobot ECPH library, see DFRobot_ESP_EC_PH_Stream.h
+ */
+
+#include "DFRobot_ESP_EC_PH_Stream.h"
+
+//both ends of the rings may run on different cores, see the header
+#ifdef ESP32
+#define STREAM_LOCK() portENTER_CRITICAL(&this->_lock)
+#define STREAM_UNLOCK() portEXIT_CRITICAL(&this->_lock)
+#else
+#define STREAM_LOCK()
+#define STREAM_UNLOCK()
+#endif
+
+ECPHBufferStream::ECPHBufferStream()
+{
+    this->_inHead = 0;
+    this->_inCount = 0;
+    this->_outHead = 0;
+    this->_outCount = 0;
+#ifdef ESP32
+    portMUX_INITIALIZE(&this->_lock);
+#endif
+}
+
+size_t ECPHBufferStream::feed(const char *text)
+{
+    return feed((const uint8_t *)text, strlen(text));
+}
+
+size_t ECPHBufferStream::feed(const uint8_t *data, size_t length)
+{
+    size_t n = 0;
+    STREAM_LOCK();
+    while (n < length && this->_inCount < ECPH_BUFFER_STREAM_LENGTH)
+    {
+        this->_in[(this->_inHead + this->_inCount) % ECPH_BUFFER_STREAM_LENGTH] = data[n++];
+        this->_inCount++;
+    }
+    STREAM_UNLOCK();
+    return n;
+}
+
+size_t ECPHBufferStream::drain(char *buffer, size_t length)
+{
+    size_t n = 0;
+    STREAM_LOCK();
+    while (n < length && this->_outCount > 0)
+    {
+        buffer[n++] = this->_out[this->_outHead];
+        this->_outHead = (this->_outHead + 1) % ECPH_BUFFER_STREAM_LENGTH;
+        this->_outCount--;
+    }
+    STREAM_UNLOCK();
+    return n;
+}
+
+size_t ECPHBufferStream::pending()
+{
+    STREAM_LOCK();
+    size_t count = this->_outCount;
+    STREAM_UNLOCK();
+    return count;
+}
+
+int ECPHBufferStream::available()
+{
+    STREAM_LOCK();
+    int count = this->_inCount;
+    STREAM_UNLOCK();
+    return count;
+}
+
+int ECPHBufferStream::read()
+{
+    int data = -1;
+    STREAM_LOCK();
+    if (this->_inCount > 0)
+    {
+        data = this->_in[this->_inHead];
+        this->_inHead = (this->_inHead + 1) % ECPH_BUFFER_STREAM_LENGTH;
+        this->_inCount--;
+    }
+    STREAM_UNLOCK();
+    return data;
+}
+
+int ECPHBufferStream::peek()
+{
+    STREAM_LOCK();
+    int data = (this->_inCount == 0) ? -1 : this->_in[this->_inHead];
+    STREAM_UNLOCK();
+    return data;
+}
+
+size_t ECPHBufferStream::write(uint8_t data)
+{
+    STREAM_LOCK();
+    if (this->_outCount == ECPH_BUFFER_STREAM_LENGTH)
+    {
+        //reader fell behind, drop the oldest reply byte
+        this->_outHead = (this->_outHead + 1) % ECPH_BUFFER_STREAM_LENGTH;
+        this->_outCount--;
+    }
+    this->_out[(this->_outHead + this->_outCount) % ECPH_BUFFER_STREAM_LENGTH] = data;
+    this->_outCount++;
+    STREAM_UNLOCK();
+    return 1;
+}
@@ -0,0 +1,47 @@
+/*
+ * file DFRobot_ESP_EC_PH_Stream.h
+ *
+ * In-memory command stream for the Modified DFRobot ECPH library.
+ * Stands in for a pipe or local loopback: another task (or a host test)
+ * feeds command lines with feed() and collects the replies with drain(),
+ * while the library sees an ordinary Arduino Stream registered with
+ * DFRobot_ESP_EC_PH::addCommandPort().
+ *
+ * On ESP32 every call holds a portMUX spinlock for the few bytes it moves, so
+ * the feeding task may run on the other core than the one polling the meter.
+ */
+
+#ifndef _DFROBOT_ESP_EC_PH_STREAM_H_
+#define _DFROBOT_ESP_EC_PH_STREAM_H_
+
+#include "Arduino.h"
+
+#define ECPH_BUFFER_STREAM_LENGTH 128 //bytes held in each direction
+
+class ECPHBufferStream : public Stream
+{
+public:
+    ECPHBufferStream();
+    size_t feed(const char *text);                 // queue command bytes for the library, returns bytes queued
+    size_t feed(const uint8_t *data, size_t length);
+    size_t drain(char *buffer, size_t length);     // take the library replies, returns bytes copied
+    size_t pending();                              // reply bytes waiting to be drained
+
+    // Stream
+    int available();
+    int read();
+    int peek();
+    size_t write(uint8_t data);
+    using Print::write;
+
+private:
+    uint8_t _in[ECPH_BUFFER_STREAM_LENGTH];
+    uint8_t _out[ECPH_BUFFER_STREAM_LENGTH];
+    size_t _inHead, _inCount;
+    size_t _outHead, _outCount;
+#ifdef ESP32
+    portMUX_TYPE _lock;           // feed()/drain() task vs. the task polling the meter
+#endif
+};
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ * file bench/bench_acquisition.cpp
+ *
+ * Acquisition pipeline on the host:
+ *   - mock source -> readFromSource() -> readEC()/readPH(), blocks and samples per second
+ *   - ADS1115 source on the emulated bus, wall time and bus transactions per block
+ *     (readBlock() waits for the conversions, so this is the blocking cost a loop pays)
+ *   - ECPHAcquisitionScheduler on the same ADS1115 source, worst poll() call
+ *
+ * usage: bench_acquisition [seconds, default 1]
+ */
+
+#include "DFRobot_ESP_EC_PH.h"
+#include "DFRobot_ESP_EC_PH_ADC.h"
+#include "DFRobot_ESP_EC_PH_Scheduler.h"
+#include "Wire.h"
+#include <chrono>
+
+typedef std::chrono::steady_clock BenchClock;
+
+#define MOCK_LENGTH 256
+
+static double since(BenchClock::time_point start)
+{
+    return std::chrono::duration<double>(BenchClock::now() - start).count();
+}
+
+static void benchMock(DFRobot_ESP_EC_PH &meter, double seconds)
+{
+    static float ecVoltages[MOCK_LENGTH], phVoltages[MOCK_LENGTH];
+    for (int i = 0; i < MOCK_LENGTH; i++)
+    {
+        ecVoltages[i] = 300 + (i % 7) * 0.1;
+        phVoltages[i] = 1250 + (i % 5) * 0.1;
+    }
+    ECPHMockAdcSource source(ecVoltages, phVoltages, MOCK_LENGTH);
+    source.begin();
+    float ec = 0, ph = 0;
+    unsigned long blocks = 0;
+    BenchClock::time_point start = BenchClock::now();
+    double elapsed;
+    do
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            meter.readFromSource(source, 25, ec, ph);
+        }
+        blocks += 1000;
+        elapsed = since(start);
+    } while (elapsed < seconds);
+    printf("mock     %9.0f blocks/s  %10.0f samples/s  %5.0f ns per block  ec %.3f ph %.3f\n",
+           blocks / elapsed, blocks * 2.0 * ECPH_ADC_BLOCK_SIZE / elapsed, elapsed * 1e9 / blocks, ec, ph);
+}
+
+static void benchADS1115(DFRobot_ESP_EC_PH &meter, uint16_t rate, const char *name)
+{
+    ECPHADS1115Source source(Wire, ADS1115_ADDRESS, 0, 1, ADS1115_GAIN_6144MV, rate);
+    Wire.conversion[0] = 1600; //300 mV
+    Wire.conversion[1] = 6667; //1250 mV
+    source.begin();
+    float ec = 0, ph = 0;
+    const int blocks = 5;
+    unsigned long transactions = Wire.transactions;
+    BenchClock::time_point start = BenchClock::now();
+    for (int i = 0; i < blocks; i++)
+    {
+        meter.readFromSource(source, 25, ec, ph);
+    }
+    double elapsed = since(start);
+    printf("ads1115  %s  %6.1f ms blocked per block  %4.1f bus transactions per block  ec %.3f ph %.3f\n",
+           name, elapsed * 1e3 / blocks, (double)(Wire.transactions - transactions) / blocks, ec, ph);
+}
+
+static void benchScheduler(DFRobot_ESP_EC_PH &meter, double seconds)
+{
+    ECPHADS1115Source source;
+    source.begin();
+    ECPHAcquisitionScheduler scheduler(meter, source);
+    scheduler.begin();
+    double worst = 0;
+    unsigned long polls = 0;
+    BenchClock::time_point start = BenchClock::now();
+    while (since(start) < seconds)
+    {
+        BenchClock::time_point call = BenchClock::now();
+        scheduler.poll(25);
+        double cost = since(call);
+        worst = (cost > worst) ? cost : worst;
+        polls++;
+    }
+    printf("schedule %9lu polls  %6.1f us worst poll()  %5.1f EC + %5.1f pH samples/s\n",
+           polls, worst * 1e6, scheduler.ecSamplesPerSecond(), scheduler.phSamplesPerSecond());
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = (argc > 1) ? atof(argv[1]) : 1.0;
+    DFRobot_ESP_EC_PH meter;
+    meter.begin();
+    benchMock(meter, seconds);
+    benchADS1115(meter, ADS1115_RATE_860SPS, "860 SPS");
+    benchADS1115(meter, ADS1115_RATE_128SPS, "128 SPS");
+    benchScheduler(meter, seconds + 1.0); //the rates need a full rate period
+    return 0;
+}
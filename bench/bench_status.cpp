@@ -0,0 +1,53 @@
+/*
+ * file bench/bench_status.cpp
+ *
+ * Snapshots per second of statusJSON() and statusCBOR() on a calibrated meter
+ * with readings, pump timings and dosing set, into fixed stack buffers.
+ *
+ * usage: bench_status [seconds per format, default 1]
+ */
+
+#include "DFRobot_ESP_EC_PH.h"
+#include <chrono>
+
+typedef std::chrono::steady_clock BenchClock;
+
+static volatile size_t benchSink; //keeps the snapshots from being optimised away
+
+template <typename Snapshot>
+static void run(const char *name, double seconds, Snapshot snapshot)
+{
+    unsigned long count = 0;
+    size_t bytes = 0;
+    BenchClock::time_point start = BenchClock::now();
+    double elapsed = 0;
+    do
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            bytes = snapshot();
+            benchSink = bytes;
+        }
+        count += 1000;
+        elapsed = std::chrono::duration<double>(BenchClock::now() - start).count();
+    } while (elapsed < seconds);
+    printf("%-5s %8.0f snapshots/s  %6.0f ns each  %3lu bytes\n", name, count / elapsed, elapsed * 1e9 / count, (unsigned long)bytes);
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = (argc > 1) ? atof(argv[1]) : 1.0;
+    DFRobot_ESP_EC_PH meter;
+    meter.begin();
+    meter.readEC(300, 24.6);
+    meter.readPH(1250, 24.6);
+    char cmd[] = "ECPHDOWN";
+    meter.ECcalibration(300, 24.6, cmd);
+
+    char json[STATUS_JSON_MAX_LENGTH];
+    uint8_t cbor[STATUS_CBOR_MAX_LENGTH];
+    run("json", seconds, [&]() { return meter.statusJSON(json, sizeof(json)); });
+    run("cbor", seconds, [&]() { return meter.statusCBOR(cbor, sizeof(cbor)); });
+    printf("%s\n", json);
+    return 0;
+}
@@ -0,0 +1,42 @@
+/*
+ * file tests/ecph_test.h
+ *
+ * Tiny check macros shared by the host tests. Each test is its own
+ * executable and returns non zero when any check failed.
+ */
+
+#ifndef _ECPH_TEST_H_
+#define _ECPH_TEST_H_
+
+#include <math.h>
+#include <stdio.h>
+
+static int ecphTestFailures = 0;
+
+#define CHECK(cond)                                                         \
+    do                                                                      \
+    {                                                                       \
+        if (!(cond))                                                        \
+        {                                                                   \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ecphTestFailures++;                                             \
+        }                                                                   \
+    } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance)                                      \
+    do                                                                               \
+    {                                                                                \
+        double a_ = (actual), e_ = (expected);                                       \
+        if (!(fabs(a_ - e_) <= (tolerance)))                                         \
+        {                                                                            \
+            fprintf(stderr, "%s:%d: %s = %g, expected %g +/- %g\n", __FILE__, __LINE__, \
+                    #actual, a_, e_, (double)(tolerance));                           \
+            ecphTestFailures++;                                                      \
+        }                                                                            \
+    } while (0)
+
+#define TEST_RESULT()                                                              \
+    (ecphTestFailures == 0 ? (printf("passed\n"), 0)                               \
+                           : (fprintf(stderr, "%d check(s) failed\n", ecphTestFailures), 1))
+
+#endif
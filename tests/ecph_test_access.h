@@ -0,0 +1,21 @@
+/*
+ * file tests/ecph_test_access.h
+ *
+ * Reaches the private command path of DFRobot_ESP_EC_PH (the class declares
+ * ECPHTestAccess a friend), for host tests only.
+ */
+
+#ifndef _ECPH_TEST_ACCESS_H_
+#define _ECPH_TEST_ACCESS_H_
+
+#include "DFRobot_ESP_EC_PH.h"
+
+struct ECPHTestAccess
+{
+    // run one command code of cmdParse(), including the internal ones
+    static void calibration(DFRobot_ESP_EC_PH &meter, byte mode) { meter.Calibration(mode); }
+    static bool cmdFailed(DFRobot_ESP_EC_PH &meter) { return meter._cmdFailed; }
+    static byte calState(DFRobot_ESP_EC_PH &meter) { return meter._calState; }
+};
+
+#endif
@@ -0,0 +1,21 @@
+# ctest script: ecph_reprocess must give the same bytes single threaded and spread
+# over THREADS workers (a list), so the auto range is carried across chunk boundaries
+#
+#   cmake -DREPROCESS=<ecph_reprocess> -DLOG=<log.csv> -DTHREADS=<n;...> -DOPTIONS=<args> -P reprocess_threads.cmake
+
+execute_process(COMMAND ${REPROCESS} ${OPTIONS} --threads 1 ${LOG}
+                OUTPUT_VARIABLE single RESULT_VARIABLE result)
+if(NOT result EQUAL 0 OR single STREQUAL "")
+    message(FATAL_ERROR "ecph_reprocess --threads 1 failed: ${result}")
+endif()
+
+foreach(threads ${THREADS})
+    execute_process(COMMAND ${REPROCESS} ${OPTIONS} --threads ${threads} ${LOG}
+                    OUTPUT_VARIABLE multi RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "ecph_reprocess --threads ${threads} failed: ${result}")
+    endif()
+    if(NOT multi STREQUAL single)
+        message(FATAL_ERROR "ecph_reprocess --threads ${threads} output differs from --threads 1")
+    endif()
+endforeach()
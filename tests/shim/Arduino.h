@@ -0,0 +1,119 @@
+/*
+ * file tests/shim/Arduino.h
+ *
+ * Minimal host stand-in for the Arduino core, enough to build the library,
+ * the tests and the benchmarks on Linux. Only the parts the library uses.
+ *
+ * millis() / micros() follow the wall clock until a test calls
+ * hostClockSet(), from then on they follow a virtual clock that only moves
+ * with hostClockAdvance() and delay(). Both wrap at 32 bits like on the ESP32.
+ * The clock may be read from the stand-in FreeRTOS tasks while a test moves it.
+ *
+ * With ESP32 defined the FreeRTOS headers come along, as with the ESP32 core.
+ */
+
+#ifndef _ECPH_HOST_ARDUINO_H_
+#define _ECPH_HOST_ARDUINO_H_
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#ifdef ESP32
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#endif
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+//----- host only -----
+void hostClockSet(uint64_t micros);      // switch to the virtual clock at this time (us)
+void hostClockAdvance(uint64_t micros);  // move the virtual clock forward (us)
+void hostClockSetMillis(uint32_t ms);    // virtual clock so millis() returns ms, e.g. just before the wrap
+void hostClockReal();                    // back to the wall clock
+
+inline char *strupr(char *s)
+{
+    for (char *p = s; *p != '\0'; p++)
+    {
+        if (*p >= 'a' && *p <= 'z')
+        {
+            *p -= 'a' - 'A';
+        }
+    }
+    return s;
+}
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t data) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+
+    size_t print(const __FlashStringHelper *text) { return print(reinterpret_cast<const char *>(text)); }
+    size_t print(const char *text) { return write((const uint8_t *)text, strlen(text)); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char value, int base = 10) { return print((unsigned long)value, base); }
+    size_t print(int value, int base = 10) { return print((long)value, base); }
+    size_t print(unsigned int value, int base = 10) { return print((unsigned long)value, base); }
+    size_t print(long value, int base = 10);
+    size_t print(unsigned long value, int base = 10);
+    size_t print(double value, int digits = 2);
+
+    template <typename T>
+    size_t println(T value) { size_t n = print(value); return n + println(); }
+    template <typename T>
+    size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+    size_t println() { return print("\r\n"); }
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    size_t readBytes(char *buffer, size_t length);
+    long parseInt(); // digits already available, 0 if none (no waiting on the host)
+};
+
+// Serial: input fed by the test, output kept for inspection
+class HardwareSerial : public Stream
+{
+public:
+    void begin(unsigned long) {}
+    int available() { return (int)(this->input.size() - this->_readPosition); }
+    int read();
+    int peek();
+    size_t write(uint8_t data);
+    using Print::write;
+
+    void feed(const char *text) { this->input += text; }
+    void clear();
+
+    std::string input;
+    std::string output;
+    bool capture = false; // keep output, off so long runs do not grow it
+
+private:
+    size_t _readPosition = 0;
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,349 @@
+/*
+ * file tests/shim/ArduinoShim.cpp
+ *
+ * Host stand-in for the Arduino core, EEPROM and Wire, see Arduino.h
+ */
+
+#include "Arduino.h"
+#include "EEPROM.h"
+#include "Wire.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+TwoWire Wire;
+
+//----- Clock -----
+
+static std::atomic<bool> virtualClock(false);
+static std::atomic<uint64_t> virtualMicros(0);
+
+static uint64_t nowMicros()
+{
+    if (virtualClock)
+    {
+        return virtualMicros;
+    }
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+unsigned long millis()
+{
+    return (uint32_t)(nowMicros() / 1000);
+}
+
+unsigned long micros()
+{
+    return (uint32_t)nowMicros();
+}
+
+void delay(unsigned long ms)
+{
+    delayMicroseconds(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    if (virtualClock)
+    {
+        virtualMicros += us;
+        return;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void hostClockSet(uint64_t micros)
+{
+    virtualClock = true;
+    virtualMicros = micros;
+}
+
+void hostClockAdvance(uint64_t micros)
+{
+    virtualMicros += micros;
+}
+
+void hostClockSetMillis(uint32_t ms)
+{
+    hostClockSet((uint64_t)ms * 1000);
+}
+
+void hostClockReal()
+{
+    virtualClock = false;
+}
+
+//----- Print / Stream -----
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+    size_t n = 0;
+    while (n < size && write(buffer[n]))
+    {
+        n++;
+    }
+    return n;
+}
+
+size_t Print::print(long value, int base)
+{
+    if (base != 10)
+    {
+        return (value < 0) ? print('-') + print((unsigned long)-value, base) : print((unsigned long)value, base);
+    }
+    char text[24];
+    snprintf(text, sizeof(text), "%ld", value);
+    return print(text);
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+    char text[72];
+    char *p = text + sizeof(text) - 1;
+    *p = '\0';
+    if (base < 2)
+    {
+        base = 10;
+    }
+    do
+    {
+        int digit = value % base;
+        *--p = (char)(digit < 10 ? '0' + digit : 'A' + digit - 10);
+        value /= base;
+    } while (value != 0);
+    return print(p);
+}
+
+size_t Print::print(double value, int digits)
+{
+    char text[64];
+    if (isnan(value))
+    {
+        return print("nan");
+    }
+    if (isinf(value))
+    {
+        return print("inf");
+    }
+    snprintf(text, sizeof(text), "%.*f", digits, value);
+    return print(text);
+}
+
+size_t Stream::readBytes(char *buffer, size_t length)
+{
+    size_t n = 0;
+    while (n < length)
+    {
+        int c = read();
+        if (c < 0)
+        {
+            break;
+        }
+        buffer[n++] = (char)c;
+    }
+    return n;
+}
+
+long Stream::parseInt()
+{
+    while (available() > 0 && peek() != '-' && (peek() < '0' || peek() > '9'))
+    {
+        read();
+    }
+    bool negative = false;
+    long value = 0;
+    if (available() > 0 && peek() == '-')
+    {
+        negative = true;
+        read();
+    }
+    while (available() > 0 && peek() >= '0' && peek() <= '9')
+    {
+        value = value * 10 + (read() - '0');
+    }
+    return negative ? -value : value;
+}
+
+int HardwareSerial::read()
+{
+    if (this->_readPosition >= this->input.size())
+    {
+        return -1;
+    }
+    return (uint8_t)this->input[this->_readPosition++];
+}
+
+int HardwareSerial::peek()
+{
+    return (this->_readPosition >= this->input.size()) ? -1 : (uint8_t)this->input[this->_readPosition];
+}
+
+size_t HardwareSerial::write(uint8_t data)
+{
+    if (this->capture)
+    {
+        this->output += (char)data;
+    }
+    return 1;
+}
+
+void HardwareSerial::clear()
+{
+    this->input.clear();
+    this->output.clear();
+    this->_readPosition = 0;
+}
+
+//----- EEPROM -----
+
+EEPROMClass::EEPROMClass()
+{
+    erase();
+}
+
+size_t EEPROMClass::readBytes(int address, void *value, size_t length)
+{
+    if (address < 0 || address + length > HOST_EEPROM_SIZE)
+    {
+        return 0;
+    }
+    memcpy(value, this->cache + address, length);
+    return length;
+}
+
+size_t EEPROMClass::writeBytes(int address, const void *value, size_t length)
+{
+    if (address < 0 || address + length > HOST_EEPROM_SIZE)
+    {
+        return 0;
+    }
+    memcpy(this->cache + address, value, length);
+    return length;
+}
+
+float EEPROMClass::readFloat(int address)
+{
+    float value = 0;
+    readBytes(address, &value, sizeof(value));
+    return value;
+}
+
+size_t EEPROMClass::writeFloat(int address, float value)
+{
+    return writeBytes(address, &value, sizeof(value));
+}
+
+uint8_t EEPROMClass::readByte(int address)
+{
+    uint8_t value = 0;
+    readBytes(address, &value, sizeof(value));
+    return value;
+}
+
+size_t EEPROMClass::writeByte(int address, uint8_t value)
+{
+    return writeBytes(address, &value, sizeof(value));
+}
+
+bool EEPROMClass::commit()
+{
+    if (this->onCommit != NULL)
+    {
+        this->onCommit();
+    }
+    if (this->failCommits)
+    {
+        return false;
+    }
+    memcpy(this->flash, this->cache, HOST_EEPROM_SIZE);
+    this->commits++;
+    return true;
+}
+
+void EEPROMClass::erase()
+{
+    memset(this->cache, 0xFF, HOST_EEPROM_SIZE);
+    memset(this->flash, 0xFF, HOST_EEPROM_SIZE);
+    this->commits = 0;
+    this->failCommits = false;
+    this->onCommit = NULL;
+}
+
+void EEPROMClass::reboot()
+{
+    memcpy(this->cache, this->flash, HOST_EEPROM_SIZE);
+}
+
+//----- Wire, emulated ADS1115 -----
+
+#define HOST_ADS1115_REG_CONVERSION 0x00
+#define HOST_ADS1115_REG_CONFIG 0x01
+
+TwoWire::TwoWire()
+{
+    memset(this->conversion, 0, sizeof(this->conversion));
+    this->config = 0;
+    this->transactions = 0;
+    this->_txLength = 0;
+    this->_pointer = HOST_ADS1115_REG_CONVERSION;
+    this->_rxLength = 0;
+    this->_rxPosition = 0;
+}
+
+void TwoWire::beginTransmission(uint8_t)
+{
+    this->_txLength = 0;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+    if (this->_txLength >= sizeof(this->_tx))
+    {
+        return 0;
+    }
+    this->_tx[this->_txLength++] = data;
+    return 1;
+}
+
+uint8_t TwoWire::endTransmission()
+{
+    this->transactions++;
+    if (this->_txLength == 0)
+    {
+        return 0;
+    }
+    this->_pointer = this->_tx[0];
+    if (this->_pointer == HOST_ADS1115_REG_CONFIG && this->_txLength == 3)
+    {
+        this->config = (uint16_t)((this->_tx[1] << 8) | this->_tx[2]);
+    }
+    return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t, uint8_t quantity)
+{
+    this->transactions++;
+    uint16_t value = this->config;
+    if (this->_pointer == HOST_ADS1115_REG_CONVERSION)
+    {
+        value = (uint16_t)this->conversion[(this->config >> 12) & 0x03]; //single ended AIN0..3
+    }
+    this->_rx[0] = (uint8_t)(value >> 8);
+    this->_rx[1] = (uint8_t)value;
+    this->_rxLength = (quantity < 2) ? quantity : 2;
+    this->_rxPosition = 0;
+    return this->_rxLength;
+}
+
+int TwoWire::available()
+{
+    return this->_rxLength - this->_rxPosition;
+}
+
+int TwoWire::read()
+{
+    return (this->_rxPosition < this->_rxLength) ? this->_rx[this->_rxPosition++] : -1;
+}
@@ -0,0 +1,45 @@
+/*
+ * file tests/shim/EEPROM.h
+ *
+ * Host stand-in for the ESP32 EEPROM library: writes land in a RAM cache,
+ * commit() copies the cache to the "flash" image. Tests can count commits,
+ * make commits fail, and reboot by reloading the cache from flash.
+ */
+
+#ifndef _ECPH_HOST_EEPROM_H_
+#define _ECPH_HOST_EEPROM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define HOST_EEPROM_SIZE 512
+
+class EEPROMClass
+{
+public:
+    EEPROMClass();
+    bool begin(size_t size) { return size <= HOST_EEPROM_SIZE; }
+
+    size_t readBytes(int address, void *value, size_t length);
+    size_t writeBytes(int address, const void *value, size_t length);
+    float readFloat(int address);
+    size_t writeFloat(int address, float value);
+    uint8_t readByte(int address);
+    size_t writeByte(int address, uint8_t value);
+    bool commit();
+
+    //----- host only -----
+    void erase();  // blank (0xFF) cache and flash, no commits counted
+    void reboot(); // drop uncommitted cache writes, as a power cycle does
+
+    uint8_t cache[HOST_EEPROM_SIZE];
+    uint8_t flash[HOST_EEPROM_SIZE];
+    unsigned long commits;       // successful commits
+    bool failCommits;            // commit() returns false and leaves flash untouched
+    void (*onCommit)();          // called on every commit() attempt, e.g. to charge its flash time
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
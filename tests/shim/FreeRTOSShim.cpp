@@ -0,0 +1,161 @@
+/*
+ * file tests/shim/FreeRTOSShim.cpp
+ *
+ * Host stand-in for FreeRTOS, see freertos/FreeRTOS.h
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+struct HostTask
+{
+    std::thread thread;
+    std::atomic<bool> deleted;
+};
+
+struct HostSemaphore
+{
+    std::timed_mutex mutex;
+};
+
+struct HostTaskDeleted
+{
+};
+
+static std::atomic<int> liveTasks(0);
+static std::atomic<int> liveSemaphores(0);
+static thread_local HostTask *currentTask = NULL;
+
+//unwind the calling task once vTaskDelete() asked for it
+static void checkDeleted()
+{
+    if (currentTask != NULL && currentTask->deleted)
+    {
+        throw HostTaskDeleted();
+    }
+}
+
+//----- portMUX -----
+
+void vPortEnterCritical(portMUX_TYPE *mux)
+{
+    while (__atomic_exchange_n(&mux->locked, 1, __ATOMIC_ACQUIRE))
+    {
+        std::this_thread::yield();
+    }
+}
+
+void vPortExitCritical(portMUX_TYPE *mux)
+{
+    __atomic_store_n(&mux->locked, 0, __ATOMIC_RELEASE);
+}
+
+//----- Tasks -----
+
+static void taskEntry(HostTask *task, TaskFunction_t code, void *parameter)
+{
+    currentTask = task;
+    try
+    {
+        code(parameter);
+    }
+    catch (const HostTaskDeleted &)
+    {
+    }
+}
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stackDepth, void *parameter,
+                       UBaseType_t priority, TaskHandle_t *createdTask)
+{
+    (void)name;
+    (void)stackDepth;
+    (void)priority;
+    HostTask *task = new HostTask();
+    task->deleted = false;
+    liveTasks++;
+    task->thread = std::thread(taskEntry, task, code, parameter);
+    if (createdTask != NULL)
+    {
+        *createdTask = task;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL || task == currentTask)
+    {
+        currentTask->deleted = true;
+        currentTask->thread.detach(); //the handle is not freed, nothing here deletes itself
+        liveTasks--;
+        throw HostTaskDeleted();
+    }
+    task->deleted = true;
+    task->thread.join();
+    delete task;
+    liveTasks--;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ticks);
+    do
+    {
+        checkDeleted();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    } while (std::chrono::steady_clock::now() < end);
+    checkDeleted();
+}
+
+//----- Semaphores -----
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    liveSemaphores++;
+    return new HostSemaphore();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    if (ticks == 0)
+    {
+        return semaphore->mutex.try_lock() ? pdTRUE : pdFALSE;
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ticks);
+    while (!semaphore->mutex.try_lock_for(std::chrono::milliseconds(1)))
+    {
+        checkDeleted();
+        if (ticks != portMAX_DELAY && std::chrono::steady_clock::now() >= end)
+        {
+            return pdFALSE;
+        }
+    }
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    semaphore->mutex.unlock();
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    delete semaphore;
+    liveSemaphores--;
+}
+
+int hostLiveTasks()
+{
+    return liveTasks;
+}
+
+int hostLiveSemaphores()
+{
+    return liveSemaphores;
+}
@@ -0,0 +1,43 @@
+/*
+ * file tests/shim/Wire.h
+ *
+ * Host stand-in for the Arduino Wire library, talking to an emulated ADS1115:
+ * register pointer and config writes are recorded, reads of the conversion
+ * register return conversion[] of the muxed input.
+ */
+
+#ifndef _ECPH_HOST_WIRE_H_
+#define _ECPH_HOST_WIRE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+class TwoWire
+{
+public:
+    TwoWire();
+    void begin() {}
+    void beginTransmission(uint8_t address);
+    size_t write(uint8_t data);
+    uint8_t endTransmission();
+    uint8_t requestFrom(uint8_t address, uint8_t quantity);
+    int available();
+    int read();
+
+    //----- host only -----
+    int16_t conversion[4];     // raw conversion result of AIN0..AIN3
+    uint16_t config;           // last config register write
+    unsigned long transactions; // bus transactions, writes and reads
+
+private:
+    uint8_t _tx[3];
+    uint8_t _txLength;
+    uint8_t _pointer;
+    uint8_t _rx[2];
+    uint8_t _rxLength;
+    uint8_t _rxPosition;
+};
+
+extern TwoWire Wire;
+
+#endif
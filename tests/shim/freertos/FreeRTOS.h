@@ -0,0 +1,47 @@
+/*
+ * file tests/shim/freertos/FreeRTOS.h
+ *
+ * Host stand-in for the few FreeRTOS calls the library makes on ESP32, used
+ * by the ESP32 variant of the host build (ecph_esp32 in the top CMakeLists.txt).
+ * A task is a thread, a mutex a std::timed_mutex, a portMUX a spinlock, one
+ * tick is one millisecond of wall clock.
+ *
+ * A thread cannot be stopped where it is, so vTaskDelete() marks the task and
+ * waits until it reaches its next vTaskDelay() or blocking semaphore take,
+ * where it unwinds. Deleting a task that never blocks again hangs.
+ */
+
+#ifndef _ECPH_HOST_FREERTOS_H_
+#define _ECPH_HOST_FREERTOS_H_
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL pdFALSE
+#define pdPASS pdTRUE
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+typedef struct
+{
+    int locked;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZE(mux) ((mux)->locked = 0)
+#define portENTER_CRITICAL(mux) vPortEnterCritical(mux)
+#define portEXIT_CRITICAL(mux) vPortExitCritical(mux)
+
+void vPortEnterCritical(portMUX_TYPE *mux);
+void vPortExitCritical(portMUX_TYPE *mux);
+
+//----- host only -----
+int hostLiveTasks();      // tasks created and not deleted yet
+int hostLiveSemaphores(); // semaphores created and not deleted yet
+
+#endif
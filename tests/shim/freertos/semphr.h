@@ -0,0 +1,19 @@
+/*
+ * file tests/shim/freertos/semphr.h
+ *
+ * Host stand-in for FreeRTOS mutexes, see FreeRTOS.h
+ */
+
+#ifndef _ECPH_HOST_FREERTOS_SEMPHR_H_
+#define _ECPH_HOST_FREERTOS_SEMPHR_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct HostSemaphore *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+
+#endif
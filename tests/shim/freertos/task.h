@@ -0,0 +1,20 @@
+/*
+ * file tests/shim/freertos/task.h
+ *
+ * Host stand-in for FreeRTOS tasks, see FreeRTOS.h
+ */
+
+#ifndef _ECPH_HOST_FREERTOS_TASK_H_
+#define _ECPH_HOST_FREERTOS_TASK_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+typedef struct HostTask *TaskHandle_t;
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stackDepth, void *parameter,
+                       UBaseType_t priority, TaskHandle_t *createdTask);
+void vTaskDelete(TaskHandle_t task); // NULL deletes the calling task
+void vTaskDelay(TickType_t ticks);
+
+#endif
@@ -0,0 +1,56 @@
+/*
+ * file tests/test_ads1115.cpp
+ *
+ * ADS1115 source on the emulated bus: the two conversion bytes arrive high
+ * byte first and keep their sign, in block reads and single samples.
+ */
+
+#include "DFRobot_ESP_EC_PH_ADC.h"
+#include "Wire.h"
+#include "ecph_test.h"
+
+#define MV_PER_BIT (6144.0 / 32768) //ADS1115_GAIN_6144MV
+
+static void testReadBlock()
+{
+    hostClockReal(); //the source busy-waits on micros() for each conversion
+    ECPHADS1115Source source(Wire, ADS1115_ADDRESS, 0, 1, ADS1115_GAIN_6144MV, ADS1115_RATE_860SPS);
+    CHECK(source.begin());
+    Wire.conversion[0] = 0x1234; //bytes differ, a swap would read 0x3412
+    Wire.conversion[1] = -0x1234;
+    float ec[4], ph[4];
+    CHECK(source.readBlock(ec, ph, 4) == 4);
+    for (int i = 0; i < 4; i++)
+    {
+        CHECK_NEAR(ec[i], 0x1234 * MV_PER_BIT, 1e-3);
+        CHECK_NEAR(ph[i], -0x1234 * MV_PER_BIT, 1e-3);
+    }
+}
+
+//the scheduler path: one sample per call once the mux has settled
+static void testReadSample()
+{
+    hostClockReal();
+    ECPHADS1115Source source(Wire, ADS1115_ADDRESS, 0, 1, ADS1115_GAIN_6144MV, ADS1115_RATE_860SPS);
+    CHECK(source.begin());
+    Wire.conversion[1] = -0x1234;
+    CHECK(source.selectChannel(ECPH_CHANNEL_PH));
+    float millivolts = 0;
+    int samples = 0;
+    for (unsigned long start = micros(); samples < 3 && micros() - start < 1000000UL;)
+    {
+        if (source.readSample(millivolts))
+        {
+            CHECK_NEAR(millivolts, -0x1234 * MV_PER_BIT, 1e-3);
+            samples++;
+        }
+    }
+    CHECK(samples == 3);
+}
+
+int main()
+{
+    testReadBlock();
+    testReadSample();
+    return TEST_RESULT();
+}
@@ -0,0 +1,127 @@
+/*
+ * file tests/test_batch.cpp
+ *
+ * runBatch(): a good script is saved with one commit, a failing step rolls
+ * everything back, a failed commit is reported and retried, and the result
+ * line goes to the stream the script came from.
+ */
+
+#include "DFRobot_ESP_EC_PH.h"
+#include "DFRobot_ESP_EC_PH_Stream.h"
+#include "EEPROM.h"
+#include "ecph_test.h"
+#include <string>
+
+static const char goodScript[] = "ENTEREC;CALEC=232@25;CALEC=2112@25;EXITEC";
+
+static std::string take(ECPHBufferStream &port)
+{
+    std::string text;
+    char buffer[64];
+    size_t n;
+    while ((n = port.drain(buffer, sizeof(buffer))) > 0)
+    {
+        text.append(buffer, n);
+    }
+    return text;
+}
+
+static bool contains(const std::string &text, const char *needle)
+{
+    return text.find(needle) != std::string::npos;
+}
+
+static bool flashKvalues(float &low, float &high)
+{
+    memcpy(&low, &EEPROM.flash[KVALUEADDR], sizeof(float));
+    memcpy(&high, &EEPROM.flash[KVALUEADDR + sizeof(float)], sizeof(float));
+    return low > 0.5f && low < 2.0f && high > 0.5f && high < 2.0f; //blank until calibrated
+}
+
+static void freshMeter(DFRobot_ESP_EC_PH &meter)
+{
+    hostClockSetMillis(1000);
+    EEPROM.erase();
+    EEPROM.failCommits = false;
+    meter.begin();
+}
+
+static void testCommit()
+{
+    DFRobot_ESP_EC_PH meter;
+    ECPHBufferStream gateway;
+    freshMeter(meter);
+    unsigned long commits = EEPROM.commits;
+
+    CHECK(meter.runBatch(goodScript, gateway));
+    CHECK(EEPROM.commits == commits + 1);
+    CHECK(!meter.isCommitPending());
+    float low, high;
+    CHECK(flashKvalues(low, high));
+    CHECK(low != high); //both points calibrated
+    CHECK(contains(take(gateway), ">>>Batch executed and saved, steps: 4<<<"));
+}
+
+static void testRollback()
+{
+    DFRobot_ESP_EC_PH meter;
+    ECPHBufferStream gateway;
+    freshMeter(meter);
+    unsigned long commits = EEPROM.commits;
+    float before = meter.readEC(1000, 25);
+
+    CHECK(!meter.runBatch("ENTEREC;CALEC=232@25;CALEC=5@25;EXITEC", gateway)); //no buffer reads 5 mV
+    CHECK(EEPROM.commits == commits);
+    CHECK(!meter.isCommitPending());
+    CHECK(meter.readEC(1000, 25) == before);
+    CHECK(contains(take(gateway), ">>>Batch failed and rolled back. Failed step: 3<<<"));
+
+    CHECK(!meter.runBatch("ENTEREC;CALEC=232@25", gateway)); //session left open
+    CHECK(EEPROM.commits == commits);
+    CHECK(contains(take(gateway), ">>>Batch rejected, nothing changed."));
+}
+
+//the values stay in effect and the commit is retried, but the caller hears about it
+static void testCommitFailure()
+{
+    DFRobot_ESP_EC_PH meter;
+    ECPHBufferStream gateway;
+    freshMeter(meter);
+    float before = meter.readEC(1000, 25);
+
+    EEPROM.failCommits = true;
+    CHECK(!meter.runBatch(goodScript, gateway));
+    std::string text = take(gateway);
+    CHECK(contains(text, ">>>Batch executed but the EEPROM commit failed, retrying. Steps: 4<<<"));
+    CHECK(!contains(text, "saved"));
+    CHECK(meter.isCommitPending());
+    CHECK(meter.readEC(1000, 25) != before);
+    float low, high;
+    CHECK(!flashKvalues(low, high));
+
+    EEPROM.failCommits = false;
+    CHECK(meter.flush());
+    CHECK(flashKvalues(low, high));
+}
+
+//without a reply stream the result goes to the first command port
+static void testDefaultReply()
+{
+    DFRobot_ESP_EC_PH meter;
+    freshMeter(meter);
+    Serial.clear();
+    Serial.capture = true;
+    CHECK(meter.runBatch(goodScript));
+    CHECK(contains(Serial.output, ">>>Batch executed and saved, steps: 4<<<"));
+    Serial.capture = false;
+    Serial.clear();
+}
+
+int main()
+{
+    testCommit();
+    testRollback();
+    testCommitFailure();
+    testDefaultReply();
+    return TEST_RESULT();
+}
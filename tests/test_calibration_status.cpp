@@ -0,0 +1,122 @@
+/*
+ * file tests/test_calibration_status.cpp
+ *
+ * Calibration status across a reboot: isCalibrated(), the reading flags and
+ * the uncertainty model follow what begin() loaded from EEPROM, not only the
+ * sessions run since power up. The defaults older releases wrote into the
+ * EEPROM still count as uncalibrated.
+ */
+
+#include "DFRobot_ESP_EC_PH.h"
+#include "DFRobot_ESP_EC_PH_Stream.h"
+#include "EEPROM.h"
+#include "ecph_test.h"
+
+static ECPHBufferStream console; //swallows the batch result lines
+
+static void testBlankEEPROM()
+{
+    hostClockSetMillis(1000);
+    EEPROM.erase();
+    DFRobot_ESP_EC_PH meter;
+    meter.begin();
+    CHECK(meter.isCalibrated() == 3);
+    CHECK(!(meter.readECExtended(1000, 25).flags & ECPH_READING_CALIBRATED));
+    CHECK(!(meter.readPHExtended(PH_7_AT_25, 25).flags & ECPH_READING_CALIBRATED));
+    CHECK(!meter.isCommitPending()); //nothing to save
+}
+
+static void testSurvivesReboot()
+{
+    {
+        DFRobot_ESP_EC_PH meter;
+        meter.begin();
+        CHECK(meter.runBatch("ENTEREC;CALEC=232@25;CALEC=2112@25;EXITEC", console));
+        CHECK(meter.isCalibrated() == 1);
+    }
+    EEPROM.reboot();
+    {
+        DFRobot_ESP_EC_PH meter;
+        meter.begin();
+        CHECK(meter.getCalibrationDefaults() == (ECPH_DEFAULT_NEUTRAL_VOLTAGE | ECPH_DEFAULT_ACID_VOLTAGE | ECPH_DEFAULT_PH_CAL_TEMPERATURE));
+        CHECK(meter.isCalibrated() == 1); //the saved K values count, the pH voltages were never calibrated
+        ECPHReading ec = meter.readECExtended(1000, 25);
+        CHECK(ec.flags & ECPH_READING_CALIBRATED);
+        CHECK_NEAR(ec.uncertainty, ec.value * EC_UNCERTAINTY_CALIBRATED, 1e-4);
+        CHECK(meter.runBatch("ENTERPH;CALPH=1130@25;CALPH=1525@25;EXITPH", console));
+        CHECK(meter.isCalibrated() == 0);
+    }
+    EEPROM.reboot();
+    {
+        DFRobot_ESP_EC_PH meter;
+        meter.begin();
+        CHECK(meter.isCalibrated() == 0);
+        ECPHReading ph = meter.readPHExtended(1300, 25);
+        CHECK(ph.flags & ECPH_READING_CALIBRATED);
+        CHECK_NEAR(ph.uncertainty, PH_UNCERTAINTY_CALIBRATED, 1e-4);
+    }
+}
+
+//the session flags alone used to say "not calibrated" on every boot
+static void testDefaultsTrackSessions()
+{
+    EEPROM.erase();
+    DFRobot_ESP_EC_PH meter;
+    meter.begin();
+    byte defaults = meter.getCalibrationDefaults();
+    CHECK(meter.runBatch("ENTEREC;CALEC=232@25;EXITEC", console)); //low point only
+    CHECK(meter.getCalibrationDefaults() == (defaults & ~ECPH_DEFAULT_KVALUE_LOW));
+    CHECK(meter.isCalibrated() == 3);                               //the high K value is still the default
+    CHECK(meter.runBatch("ENTEREC;CALEC=2112@25;EXITEC", console)); //then the high point
+    CHECK(meter.isCalibrated() == 1);
+    CHECK(!meter.runBatch("ENTERPH;CALPH=1130@25;CALPH=5@25;EXITPH", console)); //rolled back
+    CHECK(meter.getCalibrationDefaults() == (defaults & ~(ECPH_DEFAULT_KVALUE_LOW | ECPH_DEFAULT_KVALUE_HIGH)));
+}
+
+static void writeFlashFloat(int address, float value)
+{
+    memcpy(&EEPROM.flash[address], &value, sizeof(float));
+}
+
+//older releases wrote the defaults on first boot, an upgraded unit must not read them as calibrated
+static void testLegacyDefaults()
+{
+    EEPROM.erase();
+    writeFlashFloat(KVALUEADDR, 1.0f);
+    writeFlashFloat(KVALUEADDR + sizeof(float), 1.0f);
+    writeFlashFloat(PHVALUEADDR, PH_7_AT_25);
+    writeFlashFloat(PHVALUEADDR + sizeof(float), PH_4_AT_25);
+    EEPROM.reboot();
+    DFRobot_ESP_EC_PH meter;
+    meter.begin();
+    CHECK(meter.getCalibrationDefaults() == (ECPH_DEFAULT_KVALUE_LOW | ECPH_DEFAULT_KVALUE_HIGH | ECPH_DEFAULT_NEUTRAL_VOLTAGE |
+                                             ECPH_DEFAULT_ACID_VOLTAGE | ECPH_DEFAULT_PH_CAL_TEMPERATURE));
+    CHECK(meter.isCalibrated() == 3);
+    ECPHReading ec = meter.readECExtended(1000, 25);
+    CHECK(!(ec.flags & ECPH_READING_CALIBRATED));
+    CHECK_NEAR(ec.uncertainty, ec.value * EC_UNCERTAINTY_UNCALIBRATED, 1e-4);
+    ECPHReading ph = meter.readPHExtended(PH_7_AT_25, 25);
+    CHECK(!(ph.flags & ECPH_READING_CALIBRATED));
+    CHECK_NEAR(ph.uncertainty, PH_UNCERTAINTY_UNCALIBRATED, 1e-4);
+    char json[STATUS_JSON_MAX_LENGTH];
+    CHECK(meter.statusJSON(json, sizeof(json)) > 0);
+    CHECK(strstr(json, "\"ecCalibrated\":false") != NULL);
+    CHECK(strstr(json, "\"phCalibrated\":false") != NULL);
+
+    //the same image with calibrated K values
+    writeFlashFloat(KVALUEADDR, 0.98f);
+    writeFlashFloat(KVALUEADDR + sizeof(float), 1.02f);
+    EEPROM.reboot();
+    DFRobot_ESP_EC_PH upgraded;
+    upgraded.begin();
+    CHECK(upgraded.isCalibrated() == 1);
+}
+
+int main()
+{
+    testBlankEEPROM();
+    testSurvivesReboot();
+    testDefaultsTrackSessions();
+    testLegacyDefaults();
+    return TEST_RESULT();
+}
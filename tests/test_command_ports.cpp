@@ -0,0 +1,161 @@
+/*
+ * file tests/test_command_ports.cpp
+ *
+ * Command ports: every port the meter accepts (Serial plus in-memory streams)
+ * sends commands at once, split into fragments that interleave across ports.
+ * Checks that each port keeps its own line, replies go back to the sender,
+ * a value prompt gives up on a silent client, and measures command throughput.
+ */
+
+#include "DFRobot_ESP_EC_PH.h"
+#include "DFRobot_ESP_EC_PH_Stream.h"
+#include "ecph_test.h"
+#include "ecph_test_access.h"
+#include <chrono>
+#include <string>
+
+#define STREAM_PORTS (ECPH_MAX_COMMAND_PORTS - 1) //Serial takes the first port
+#define THROUGHPUT_ROUNDS 20000
+#define CMD_PUMP_ON_TIME 10                       //internal command code of the pump on time prompt
+
+static const char wrongExit[] = ">>>Wrong EXIT command detected.<<<";
+
+static unsigned long tickingNow = 0;
+
+static unsigned long tickingClock() //a clock that moves while the library spins
+{
+    return tickingNow += 1;
+}
+
+static std::string take(ECPHBufferStream &port)
+{
+    std::string text;
+    char buffer[64];
+    size_t n;
+    while ((n = port.drain(buffer, sizeof(buffer))) > 0)
+    {
+        text.append(buffer, n);
+    }
+    return text;
+}
+
+static size_t count(const std::string &text, const char *needle)
+{
+    size_t n = 0;
+    for (size_t at = text.find(needle); at != std::string::npos; at = text.find(needle, at + 1))
+    {
+        n++;
+    }
+    return n;
+}
+
+//fragments of different commands interleave, each port assembles its own line
+static void testInterleavedLines()
+{
+    hostClockSetMillis(1000);
+    Serial.clear();
+    Serial.capture = true;
+    DFRobot_ESP_EC_PH meter;
+    ECPHBufferStream ports[STREAM_PORTS];
+    meter.begin();
+    for (int i = 0; i < STREAM_PORTS; i++)
+    {
+        CHECK(meter.addCommandPort(ports[i]));
+    }
+    ECPHBufferStream extra;
+    CHECK(!meter.addCommandPort(extra)); //all ports taken
+
+    ports[0].feed("ECPH");
+    Serial.feed("EXIT");
+    ports[1].feed("EXI");
+    meter.update();
+    CHECK(!meter.ecphcontrol());
+    ports[0].feed("DOWN\n");
+    Serial.feed("PH\n");
+    ports[1].feed("TEC\n");
+    meter.update();
+    CHECK(meter.ecphcontrol());
+
+    //replies only go to the port that sent the command
+    CHECK(count(Serial.output, wrongExit) == 1);
+    CHECK(count(take(ports[1]), wrongExit) == 1);
+    CHECK(take(ports[0]).empty());
+    for (int i = 2; i < STREAM_PORTS; i++)
+    {
+        CHECK(take(ports[i]).empty());
+    }
+    Serial.capture = false;
+    Serial.clear();
+}
+
+//a pump value prompt on a port whose client went silent gives up after ECPH_CMD_TIMEOUT
+static void testValuePromptTimeout()
+{
+    DFRobot_ESP_EC_PH meter;
+    ECPHBufferStream port;
+    meter.begin();
+    meter.addCommandPort(port);
+    meter.setClock(tickingClock);
+
+    port.feed("ECPHUP\n");
+    meter.update(); //makes the port the active one
+    port.feed("1500\n");
+    ECPHTestAccess::calibration(meter, CMD_PUMP_ON_TIME);
+    CHECK(!ECPHTestAccess::cmdFailed(meter));
+    CHECK(meter.pumpgetOnTime() == 1500);
+    take(port);
+
+    unsigned long start = tickingNow;
+    ECPHTestAccess::calibration(meter, CMD_PUMP_ON_TIME); //nothing follows
+    CHECK(ECPHTestAccess::cmdFailed(meter));
+    CHECK(tickingNow - start > ECPH_CMD_TIMEOUT);
+    CHECK(tickingNow - start < 2 * ECPH_CMD_TIMEOUT);
+}
+
+static void testThroughput()
+{
+    hostClockSetMillis(1000);
+    Serial.clear();
+    DFRobot_ESP_EC_PH meter;
+    ECPHBufferStream ports[STREAM_PORTS];
+    meter.begin();
+    for (int i = 0; i < STREAM_PORTS; i++)
+    {
+        meter.addCommandPort(ports[i]);
+    }
+
+    size_t replies[STREAM_PORTS] = {0};
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int round = 0; round < THROUGHPUT_ROUNDS; round++)
+    {
+        for (int i = 0; i < STREAM_PORTS; i++)
+        {
+            ports[i].feed("EXITEC\n");
+        }
+        Serial.feed("ECPHUP\n");
+        meter.update();
+        for (int i = 0; i < STREAM_PORTS; i++)
+        {
+            replies[i] += count(take(ports[i]), wrongExit);
+        }
+        hostClockAdvance(1000);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (int i = 0; i < STREAM_PORTS; i++)
+    {
+        CHECK(replies[i] == THROUGHPUT_ROUNDS); //no command lost, no reply on the wrong port
+    }
+    CHECK(Serial.available() == 0);
+    unsigned long commands = THROUGHPUT_ROUNDS * (STREAM_PORTS + 1UL);
+    printf("%lu commands over %d ports in %.3f s, %.0f commands/s\n", commands, STREAM_PORTS + 1, seconds, commands / seconds);
+    Serial.clear();
+}
+
+int main()
+{
+    testInterleavedLines();
+    testValuePromptTimeout();
+    testThroughput();
+    return TEST_RESULT();
+}
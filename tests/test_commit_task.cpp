@@ -0,0 +1,104 @@
+/*
+ * file tests/test_commit_task.cpp
+ *
+ * ESP32 build (ecph_esp32, FreeRTOS stand-in): begin() starts the commit task,
+ * which commits staged values once quiet without the sketch calling idle();
+ * the destructor waits out a commit in progress, stops the task and frees
+ * the EEPROM mutex.
+ */
+
+#include "DFRobot_ESP_EC_PH.h"
+#include "DFRobot_ESP_EC_PH_Stream.h"
+#include "EEPROM.h"
+#include "ecph_test.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+static std::atomic<bool> inCommit(false);
+
+//a slow flash write, long enough for the destructor to run into it
+static void slowCommit()
+{
+    inCommit = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    inCommit = false;
+}
+
+static void sleepMillis(unsigned long ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+static void calibrateEC(DFRobot_ESP_EC_PH &meter, ECPHBufferStream &port)
+{
+    meter.readEC(232, 25);
+    port.feed("ENTEREC\nCALEC\nEXITEC\n");
+    meter.ECcalibration(232, 25);
+    CHECK(meter.getCalibrationMode() == 0);
+}
+
+static void testCommitTask()
+{
+    EEPROM.erase();
+    EEPROM.onCommit = NULL;
+    hostClockSetMillis(1000);
+    {
+        DFRobot_ESP_EC_PH meter;
+        ECPHBufferStream port;
+        meter.begin();
+        meter.begin(); //again, still one task and one mutex
+        meter.addCommandPort(port);
+        CHECK(hostLiveTasks() == 1);
+        CHECK(hostLiveSemaphores() == 1);
+        unsigned long commits = EEPROM.commits;
+
+        calibrateEC(meter, port);
+        CHECK(meter.isCommitPending());
+        sleepMillis(3 * ECPH_COMMIT_TASK_PERIOD); //the task runs, the commit delay has not passed
+        CHECK(EEPROM.commits == commits);
+
+        hostClockAdvance(ECPH_COMMIT_DELAY * 1000ULL);
+        for (int i = 0; i < 100 && meter.isCommitPending(); i++)
+        {
+            sleepMillis(ECPH_COMMIT_TASK_PERIOD / 4);
+        }
+        CHECK(!meter.isCommitPending());
+        CHECK(EEPROM.commits == commits + 1);
+    }
+    CHECK(hostLiveTasks() == 0);
+    CHECK(hostLiveSemaphores() == 0);
+}
+
+static void testDestroyDuringCommit()
+{
+    EEPROM.erase();
+    EEPROM.onCommit = slowCommit;
+    hostClockSetMillis(1000);
+    unsigned long commits = EEPROM.commits;
+    {
+        DFRobot_ESP_EC_PH meter;
+        ECPHBufferStream port;
+        meter.begin();
+        meter.addCommandPort(port);
+        calibrateEC(meter, port);
+        hostClockAdvance(ECPH_COMMIT_DELAY * 1000ULL);
+        for (int i = 0; i < 100 && !inCommit; i++)
+        {
+            sleepMillis(ECPH_COMMIT_TASK_PERIOD / 4);
+        }
+        CHECK(inCommit);
+    }
+    CHECK(!inCommit); //the destructor waited for the flash write
+    CHECK(EEPROM.commits == commits + 1);
+    CHECK(hostLiveTasks() == 0);
+    CHECK(hostLiveSemaphores() == 0);
+    EEPROM.onCommit = NULL;
+}
+
+int main()
+{
+    testCommitTask();
+    testDestroyDuringCommit();
+    return TEST_RESULT();
+}
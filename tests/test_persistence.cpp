@@ -0,0 +1,138 @@
+/*
+ * file tests/test_persistence.cpp
+ *
+ * Deferred EEPROM persistence: no reading or polling call commits, even long
+ * after values were staged; idle() commits once quiet and coalesces a burst
+ * of changes; flush() is the durability point across a reboot.
+ */
+
+#include "DFRobot_ESP_EC_PH.h"
+#include "DFRobot_ESP_EC_PH_ADC.h"
+#include "DFRobot_ESP_EC_PH_Scheduler.h"
+#include "DFRobot_ESP_EC_PH_Stream.h"
+#include "EEPROM.h"
+#include "ecph_test.h"
+
+static const char *pollingCall = NULL; //set while the test is inside a polling call
+static unsigned long pollingCommits = 0;
+
+static void commitHook()
+{
+    if (pollingCall != NULL)
+    {
+        fprintf(stderr, "commit from %s\n", pollingCall);
+        pollingCommits++;
+    }
+}
+
+#define POLLING(call)          \
+    do                         \
+    {                          \
+        pollingCall = #call;   \
+        call;                  \
+        pollingCall = NULL;    \
+    } while (0)
+
+static const float ecVoltages[] = {232};
+static const float phVoltages[] = {PH_7_AT_25};
+
+static void calibrateEC(DFRobot_ESP_EC_PH &meter, ECPHBufferStream &port)
+{
+    meter.readEC(232, 25);
+    port.feed("ENTEREC\nCALEC\nEXITEC\n");
+    meter.ECcalibration(232, 25);
+    CHECK(meter.getCalibrationMode() == 0);
+}
+
+static void testNoCommitWhilePolling()
+{
+    EEPROM.erase();
+    EEPROM.onCommit = commitHook;
+    hostClockSetMillis(1000);
+    DFRobot_ESP_EC_PH meter;
+    ECPHBufferStream port;
+    meter.begin();
+    meter.addCommandPort(port);
+    ECPHMockAdcSource source(ecVoltages, phVoltages, 1);
+    source.begin();
+    ECPHAcquisitionScheduler scheduler(meter, source);
+    scheduler.begin();
+
+    calibrateEC(meter, port);
+    CHECK(meter.isCommitPending());
+    char cmd[] = "ECPHUP";
+    for (int i = 0; i < 100; i++) //ten times the commit delay
+    {
+        hostClockAdvance(ECPH_COMMIT_DELAY * 100UL);
+        POLLING(meter.readEC(232, 25));
+        POLLING(meter.readPH(PH_7_AT_25, 25));
+        POLLING(meter.readECExtended(232, 25));
+        POLLING(meter.readPHExtended(PH_7_AT_25, 25));
+        POLLING(meter.ECcalibration(232, 25));
+        POLLING(meter.PHcalibration(PH_7_AT_25, 25));
+        POLLING(meter.ECcalibration(232, 25, cmd));
+        POLLING(meter.update());
+        POLLING(meter.nutrientpump());
+        POLLING(scheduler.poll(25));
+    }
+    CHECK(pollingCommits == 0);
+    CHECK(EEPROM.commits == 0);
+    CHECK(meter.isCommitPending());
+
+    meter.idle(); //the explicit hook
+    CHECK(EEPROM.commits == 1);
+    CHECK(!meter.isCommitPending());
+    EEPROM.onCommit = NULL;
+}
+
+//changes keep restarting the delay, the burst costs one commit
+static void testCoalescing()
+{
+    EEPROM.erase();
+    hostClockSetMillis(1000);
+    DFRobot_ESP_EC_PH meter;
+    ECPHBufferStream port;
+    meter.begin();
+    meter.addCommandPort(port);
+    for (int i = 0; i < 5; i++)
+    {
+        calibrateEC(meter, port);
+        hostClockAdvance((ECPH_COMMIT_DELAY / 2) * 1000UL);
+        meter.idle();
+    }
+    CHECK(EEPROM.commits == 0);
+    hostClockAdvance((ECPH_COMMIT_DELAY / 2) * 1000UL);
+    meter.idle();
+    CHECK(EEPROM.commits == 1);
+}
+
+//flush() does not wait for the delay, the values survive a reboot right after it
+static void testFlushBeforeReboot()
+{
+    EEPROM.erase();
+    hostClockSetMillis(1000);
+    ECPHBufferStream port;
+    float calibrated;
+    {
+        DFRobot_ESP_EC_PH meter;
+        meter.begin();
+        meter.addCommandPort(port);
+        calibrateEC(meter, port);
+        calibrated = meter.readEC(232, 25);
+        CHECK(meter.flush());
+        CHECK(EEPROM.commits == 1);
+    }
+    EEPROM.reboot();
+    DFRobot_ESP_EC_PH meter;
+    meter.begin();
+    CHECK_NEAR(meter.readEC(232, 25), calibrated, 1e-4);
+    CHECK(!(meter.getCalibrationDefaults() & ECPH_DEFAULT_KVALUE_LOW));
+}
+
+int main()
+{
+    testNoCommitWhilePolling();
+    testCoalescing();
+    testFlushBeforeReboot();
+    return TEST_RESULT();
+}
@@ -0,0 +1,87 @@
+/*
+ * file tests/test_ph_calibration.cpp
+ *
+ * pH calibration temperature: CALPH refuses a buffer temperature begin() would
+ * not load back, and the temperature is stored after the K values wherever
+ * begin() puts them.
+ */
+
+#include "DFRobot_ESP_EC_PH.h"
+#include "DFRobot_ESP_EC_PH_Stream.h"
+#include "EEPROM.h"
+#include "ecph_test.h"
+#include "ecph_test_access.h"
+
+static ECPHBufferStream console;
+
+static float flashFloat(int address)
+{
+    float value;
+    memcpy(&value, &EEPROM.flash[address], sizeof(float));
+    return value;
+}
+
+static void calph(DFRobot_ESP_EC_PH &meter, float voltage, float temperature)
+{
+    meter.PHcalibration(voltage, temperature);
+    ECPHTestAccess::calibration(meter, 5);
+}
+
+//a disconnected sensor reads -127C, a failed conversion NaN
+static void testInvalidTemperature()
+{
+    hostClockSetMillis(1000);
+    EEPROM.erase();
+    DFRobot_ESP_EC_PH meter;
+    meter.begin();
+    float before = meter.readPH(1300, 25);
+    ECPHTestAccess::calibration(meter, 4);
+    const float invalid[] = {-127, NAN, 0, 60.5};
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        calph(meter, 1130, invalid[i]);
+        CHECK(ECPHTestAccess::cmdFailed(meter));
+        CHECK(meter.getCalibrationMode() == 2); //the pH session stays open
+        CHECK(meter.getPHCalibrationTemperature() == PH_CAL_TEMPERATURE_DEFAULT);
+        CHECK(meter.readPH(1300, 25) == before);
+    }
+    calph(meter, 1130, 60); //the limits begin() accepts
+    CHECK(!ECPHTestAccess::cmdFailed(meter));
+    CHECK(meter.getPHCalibrationTemperature() == 60);
+    ECPHTestAccess::calibration(meter, 6);
+    CHECK(meter.getCalibrationMode() == 0);
+
+    ECPHBufferStream reply;
+    CHECK(!meter.runBatch("ENTERPH;CALPH=1130@-127;CALPH=1525@25;EXITPH", reply));
+    char text[128] = {0};
+    reply.drain(text, sizeof(text) - 1);
+    CHECK(strstr(text, "Failed step: 2") != NULL); //the bad CALPH, not a rejected script
+    CHECK(meter.getPHCalibrationTemperature() == 60);
+}
+
+static void testTemperatureFollowsKValues()
+{
+    const int ecAddress = 16;
+    EEPROM.erase();
+    DFRobot_ESP_EC_PH meter;
+    meter.begin(ecAddress, PHVALUEADDR);
+    CHECK(meter.runBatch("ENTEREC;CALEC=232@25;CALEC=2112@25;EXITEC", console));
+    CHECK(meter.runBatch("ENTERPH;CALPH=1130@22;CALPH=1525@22;EXITPH", console));
+    float kvalueLow = flashFloat(ecAddress);
+    float kvalueHigh = flashFloat(ecAddress + sizeof(float));
+    CHECK(kvalueLow > 0.5f && kvalueLow < 2.0f && kvalueHigh > 0.5f && kvalueHigh < 2.0f);
+    CHECK(flashFloat(ecAddress + 2 * sizeof(float)) == 22.0f);
+
+    EEPROM.reboot();
+    DFRobot_ESP_EC_PH rebooted;
+    rebooted.begin(ecAddress, PHVALUEADDR);
+    CHECK(rebooted.getCalibrationDefaults() == 0);
+    CHECK(rebooted.getPHCalibrationTemperature() == 22.0f);
+}
+
+int main()
+{
+    testInvalidTemperature();
+    testTemperatureFollowsKValues();
+    return TEST_RESULT();
+}
@@ -0,0 +1,163 @@
+/*
+ * file tests/test_sampling.cpp
+ *
+ * Adaptive sampling governor: unit checks of the back-off rules, then a replay
+ * of a 12 h reservoir trace (tests/data/replay_reservoir.csv) sampled only when
+ * isSampleDue() says so, with the dosing commands of the trace.
+ */
+
+#include "DFRobot_ESP_EC_PH.h"
+#include "ecph_test.h"
+#include <vector>
+
+#define REPLAY_STEP 100UL //simulated ms per loop iteration
+
+struct TraceRow
+{
+    float ecVoltage;
+    float phVoltage;
+    float temperature;
+    char event[12];
+};
+
+static bool loadTrace(const char *path, std::vector<TraceRow> &trace)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        perror(path);
+        return false;
+    }
+    char line[128];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        TraceRow row;
+        int minute;
+        row.event[0] = '\0';
+        if (line[0] < '0' || line[0] > '9' ||
+            sscanf(line, "%d,%f,%f,%f,%11[A-Z]", &minute, &row.ecVoltage, &row.phVoltage, &row.temperature, row.event) < 4)
+        {
+            continue; //comments and header
+        }
+        trace.push_back(row);
+    }
+    fclose(file);
+    return !trace.empty();
+}
+
+//one interval step per readEC() + readPH() cycle, not per read call
+static void testGrowthPerCycle()
+{
+    hostClockSetMillis(1000);
+    DFRobot_ESP_EC_PH meter;
+    meter.begin();
+    for (int i = 0; i < 4; i++)
+    {
+        hostClockAdvance(SAMPLE_INTERVAL_MIN * 1000UL);
+        meter.readEC(300, 25);
+        meter.readPH(PH_7_AT_25, 25);
+    }
+    unsigned long before = meter.sampleInterval();
+    hostClockAdvance(before * 1000UL);
+    meter.readEC(300, 25);
+    CHECK(meter.sampleInterval() == before); //half a cycle
+    meter.readPH(PH_7_AT_25, 25);
+    CHECK(meter.sampleInterval() == before + before / 2);
+}
+
+//a sketch that only reads EC still backs off
+static void testSingleChannel()
+{
+    hostClockSetMillis(1000);
+    DFRobot_ESP_EC_PH meter;
+    meter.begin();
+    for (int i = 0; i < 200; i++)
+    {
+        hostClockAdvance(meter.sampleInterval() * 1000UL);
+        meter.readEC(300, 25);
+    }
+    CHECK(meter.sampleInterval() == SAMPLE_INTERVAL_MAX);
+
+    DFRobot_ESP_EC_PH phOnly;
+    phOnly.begin();
+    for (int i = 0; i < 200; i++)
+    {
+        hostClockAdvance(phOnly.sampleInterval() * 1000UL);
+        phOnly.readPH(PH_7_AT_25, 25);
+    }
+    CHECK(phOnly.sampleInterval() == SAMPLE_INTERVAL_MAX);
+}
+
+static void testReplay(const char *path)
+{
+    std::vector<TraceRow> trace;
+    CHECK(loadTrace(path, trace));
+    if (trace.empty())
+    {
+        return;
+    }
+
+    hostClockSetMillis(0);
+    DFRobot_ESP_EC_PH meter;
+    meter.begin();
+    unsigned long samples = 0;
+    unsigned long stableSamples = 0; //during the second hour
+    unsigned long stepSamples = 0;   //first minute after the 6:00 top up
+    int lastMinute = -1;
+    const unsigned long iterations = trace.size() * 60000UL / REPLAY_STEP;
+
+    for (unsigned long i = 0; i < iterations; i++)
+    {
+        unsigned long now = i * REPLAY_STEP;
+        int minute = now / 60000UL;
+        const TraceRow &row = trace[minute];
+        hostClockSetMillis(now);
+
+        if (minute != lastMinute && row.event[0] != '\0')
+        {
+            char cmd[sizeof(row.event)];
+            strcpy(cmd, row.event);
+            meter.ECcalibration(row.ecVoltage, row.temperature, cmd);
+            CHECK(meter.sampleInterval() == SAMPLE_INTERVAL_MIN); //dosing, sample fast again
+        }
+        lastMinute = minute;
+
+        if (!meter.isSampleDue())
+        {
+            continue;
+        }
+        meter.readEC(row.ecVoltage, row.temperature);
+        meter.readPH(row.phVoltage, row.temperature);
+        samples++;
+        if (minute >= 60 && minute < 120)
+        {
+            stableSamples++;
+        }
+        if (minute == 360)
+        {
+            stepSamples++;
+            if (stepSamples == 1)
+            {
+                CHECK(meter.sampleInterval() == SAMPLE_INTERVAL_MIN); //the EC step is abrupt
+            }
+        }
+        if (minute == 170)
+        {
+            CHECK(meter.sampleInterval() == SAMPLE_INTERVAL_MAX); //backed off fully before the dosing
+        }
+    }
+
+    //a fixed 1 s rate would take 3600 samples in the stable hour
+    CHECK(stableSamples > 0 && stableSamples <= 3600 / (SAMPLE_INTERVAL_MAX / 1000) + 1);
+    CHECK(stepSamples > 1);
+    CHECK(samples < iterations * REPLAY_STEP / SAMPLE_INTERVAL_MIN / 10);
+    printf("replay: %lu samples in %lu min, %lu in the stable hour\n", samples, (unsigned long)trace.size(), stableSamples);
+}
+
+int main(int argc, char **argv)
+{
+    testGrowthPerCycle();
+    testSingleChannel();
+    testReplay(argc > 1 ? argv[1] : "data/replay_reservoir.csv");
+    return TEST_RESULT();
+}
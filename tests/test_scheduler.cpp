@@ -0,0 +1,98 @@
+/*
+ * file tests/test_scheduler.cpp
+ *
+ * Acquisition scheduler against the mock source with modelled EC excitation
+ * crosstalk: the default blanking keeps pH clean, no blanking corrupts it.
+ * Also checks the reported samples/sec against the window timing.
+ */
+
+#include "DFRobot_ESP_EC_PH.h"
+#include "DFRobot_ESP_EC_PH_ADC.h"
+#include "DFRobot_ESP_EC_PH_Scheduler.h"
+#include "ecph_test.h"
+
+#define POLL_STEP 1            //simulated ms between poll() calls
+#define RUN_MS 10000UL
+#define CROSSTALK_OFFSET 300.0 //mV on the pH electrode right after the EC window
+#define CROSSTALK_DECAY 200    //ms until it has faded, shorter than ECPH_SCHED_BLANKING
+
+static const float ecVoltages[] = {300};
+static const float phVoltages[] = {PH_7_AT_25};
+
+struct RunResult
+{
+    float phMin;
+    float phMax;
+    unsigned long phValues;
+    float ecRate; //mean of the rates reported each ECPH_SCHED_RATE_PERIOD
+    float phRate;
+};
+
+static RunResult run(unsigned long blanking)
+{
+    hostClockSetMillis(5000);
+    DFRobot_ESP_EC_PH meter;
+    meter.begin();
+    ECPHMockAdcSource source(ecVoltages, phVoltages, 1);
+    source.begin();
+    source.setInterference(CROSSTALK_OFFSET, CROSSTALK_DECAY, millis);
+    ECPHAcquisitionScheduler scheduler(meter, source);
+    scheduler.setTiming(ECPH_SCHED_EC_SETTLE, ECPH_SCHED_EC_WINDOW, blanking, ECPH_SCHED_PH_WINDOW);
+    scheduler.begin();
+
+    RunResult result = {100, -100, 0, 0, 0};
+    unsigned long periods = 0;
+    for (unsigned long t = 0; t < RUN_MS; t += POLL_STEP)
+    {
+        scheduler.poll(25);
+        if (t > 0 && t % ECPH_SCHED_RATE_PERIOD == 0)
+        {
+            result.ecRate += scheduler.ecSamplesPerSecond();
+            result.phRate += scheduler.phSamplesPerSecond();
+            periods++;
+        }
+        if (scheduler.hasPH())
+        {
+            float ph = scheduler.ph();
+            result.phMin = (ph < result.phMin) ? ph : result.phMin;
+            result.phMax = (ph > result.phMax) ? ph : result.phMax;
+            result.phValues++;
+        }
+        hostClockAdvance(POLL_STEP * 1000UL);
+    }
+    result.ecRate /= periods;
+    result.phRate /= periods;
+    printf("blanking %3lu ms: pH %.2f..%.2f over %lu windows, %.0f EC + %.0f pH samples/s\n", blanking,
+           result.phMin, result.phMax, result.phValues, result.ecRate, result.phRate);
+    return result;
+}
+
+static void checkBlanking(const RunResult &clean, const RunResult &corrupted)
+{
+    CHECK(clean.phValues > 0);
+    CHECK_NEAR(clean.phMin, 7.0, 0.01);
+    CHECK_NEAR(clean.phMax, 7.0, 0.01);
+    CHECK(corrupted.phValues > clean.phValues); //shorter cycle
+    CHECK(corrupted.phMax < 6.0);               //every window starts inside the crosstalk
+}
+
+//one sample per poll inside the windows: rate = window / cycle length, a single
+//rate period holds one or two pH windows so only the mean is exact
+static void checkSampleRate(const RunResult &result, unsigned long blanking)
+{
+    float cycle = ECPH_SCHED_EC_SETTLE + ECPH_SCHED_EC_WINDOW + blanking + ECPH_SCHED_PH_WINDOW;
+    float ecExpected = 1000.0 / POLL_STEP * ECPH_SCHED_EC_WINDOW / cycle;
+    float phExpected = 1000.0 / POLL_STEP * ECPH_SCHED_PH_WINDOW / cycle;
+    CHECK_NEAR(result.ecRate, ecExpected, ecExpected * 0.1);
+    CHECK_NEAR(result.phRate, phExpected, phExpected * 0.1);
+}
+
+int main()
+{
+    RunResult clean = run(ECPH_SCHED_BLANKING);
+    RunResult corrupted = run(0);
+    checkBlanking(clean, corrupted);
+    checkSampleRate(clean, ECPH_SCHED_BLANKING);
+    checkSampleRate(corrupted, 0);
+    return TEST_RESULT();
+}
@@ -0,0 +1,219 @@
+/*
+ * file tests/test_soak.cpp
+ *
+ * Virtual clock soak run: three weeks of loop() iterations in a few seconds,
+ * with the 32 bit millis() wrap in the first week. Drives readings, pump
+ * commands and daily EC calibrations over a command port, checks the
+ * sample schedule, the command timeout and the commit delay on every
+ * iteration, and tracks the loop cost per simulated day so leaks or
+ * drift show up as a rising cost.
+ */
+
+#include "DFRobot_ESP_EC_PH.h"
+#include "DFRobot_ESP_EC_PH_Stream.h"
+#include "EEPROM.h"
+#include "ecph_test.h"
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#define SOAK_DAYS 21
+#define SOAK_STEP 250UL                         //simulated ms per loop iteration
+#define HOUR_MS 3600000UL
+#define DAY_MS (24 * HOUR_MS)
+#define SOAK_START (0xFFFFFFFFUL - 7 * DAY_MS)  //millis() wraps one week in
+#define SOAK_COST_GROWTH 4.0                    //allowed last day / first day loop cost
+
+static uint32_t noiseState = 12345;
+
+static float noise() //deterministic +/- 0.5
+{
+    noiseState = noiseState * 1103515245 + 12345;
+    return ((noiseState >> 16) & 0x7FFF) / 32768.0 - 0.5;
+}
+
+static void drain(ECPHBufferStream &port)
+{
+    char buffer[64];
+    while (port.drain(buffer, sizeof(buffer)) > 0)
+    {
+    }
+}
+
+static void command(DFRobot_ESP_EC_PH &meter, ECPHBufferStream &port, const char *line)
+{
+    port.feed(line);
+    meter.update();
+    drain(port);
+}
+
+static void ecCommand(DFRobot_ESP_EC_PH &meter, ECPHBufferStream &port, const char *line, float voltage)
+{
+    port.feed(line);
+    meter.ECcalibration(voltage, 25); //the sketch passes the probe voltage with each poll
+    drain(port);
+}
+
+//a partial command survives a short gap across the wrap, a stale one is dropped
+static void testCommandTimeoutAcrossWrap()
+{
+    hostClockSetMillis(0xFFFFFFFFUL - 200);
+    DFRobot_ESP_EC_PH meter;
+    ECPHBufferStream port;
+    meter.begin();
+    meter.addCommandPort(port);
+
+    port.feed("ECPH");
+    meter.update();
+    CHECK(!meter.ecphcontrol());
+    hostClockAdvance((ECPH_CMD_TIMEOUT - 200) * 1000UL); //crosses the wrap, still inside the timeout
+    command(meter, port, "DOWN\n");
+    CHECK(meter.ecphcontrol());
+
+    hostClockSetMillis(0xFFFFFFFFUL - 100);
+    port.feed("ECPHD");
+    meter.update();
+    hostClockAdvance((ECPH_CMD_TIMEOUT + 100) * 1000UL); //crosses the wrap, past the timeout
+    command(meter, port, "ECPHUP\n");
+    CHECK(!meter.ecphcontrol()); //"ECPHD" was discarded, otherwise the line would be "ECPHDECPH"
+}
+
+//the sample schedule and the commit delay measure elapsed time across the wrap
+static void testDeadlinesAcrossWrap()
+{
+    EEPROM.erase();
+    hostClockSetMillis(0xFFFFFFFFUL - 500);
+    DFRobot_ESP_EC_PH meter;
+    ECPHBufferStream port;
+    meter.begin();
+    meter.addCommandPort(port);
+    CHECK(!meter.isCommitPending()); //blank EEPROM, the defaults are not written back
+    meter.readEC(232, 25);
+    ecCommand(meter, port, "ENTEREC\n", 232);
+    ecCommand(meter, port, "CALEC\n", 232);
+    ecCommand(meter, port, "EXITEC\n", 232);
+    CHECK(meter.isCommitPending());
+    hostClockAdvance(1000 * 1000UL);
+    meter.idle();
+    CHECK(EEPROM.commits == 0);
+    hostClockAdvance((ECPH_COMMIT_DELAY - 1000) * 1000UL);
+    meter.idle();
+    CHECK(EEPROM.commits == 1);
+    CHECK(!meter.isCommitPending());
+
+    hostClockSetMillis(0xFFFFFFFFUL - 300);
+    meter.resetSampleInterval();
+    meter.readEC(300, 25);
+    meter.readPH(PH_7_AT_25, 25);
+    unsigned long interval = meter.sampleInterval();
+    hostClockAdvance((interval - 1) * 1000UL);
+    CHECK(!meter.isSampleDue());
+    hostClockAdvance(1000UL);
+    CHECK(meter.isSampleDue());
+    CHECK(meter.nextSampleDue() == (uint32_t)(0xFFFFFFFFUL - 300 + interval));
+}
+
+static void testSoak()
+{
+    EEPROM.erase();
+    hostClockSetMillis(SOAK_START);
+    DFRobot_ESP_EC_PH meter;
+    ECPHBufferStream port;
+    meter.begin();
+    meter.addCommandPort(port);
+
+    float ec = 300;                  //mV, about 1.5 ms/cm with K = 1
+    float ph = PH_7_AT_25;
+    unsigned long stagedAt = 0;
+    bool staged = false;
+    unsigned long commits = EEPROM.commits;
+    unsigned long longestInterval = 0;
+    unsigned long samples = 0;
+    std::vector<double> hourCost;    //ns per iteration of each simulated hour
+    std::vector<double> dayMedian;
+    const unsigned long iterationsPerHour = HOUR_MS / SOAK_STEP;
+
+    for (unsigned long hour = 0; hour < SOAK_DAYS * 24UL; hour++)
+    {
+        //events at the top of the hour
+        command(meter, port, (hour % 2 == 0) ? "ECPHDOWN\n" : "ECPHUP\n");
+        CHECK(meter.ecphcontrol() == (hour % 2 == 0));
+        CHECK(meter.sampleInterval() == SAMPLE_INTERVAL_MIN); //dosing resets the governor
+        if (hour % 24 == 12)
+        {
+            //daily recalibration against the 1.413 ms/cm buffer
+            meter.readEC(232, 25);
+            ecCommand(meter, port, "ENTEREC\n", 232);
+            ecCommand(meter, port, "CALEC\n", 232);
+            ecCommand(meter, port, "EXITEC\n", 232);
+            CHECK(meter.getCalibrationMode() == 0);
+            CHECK(meter.isCommitPending());
+            staged = true;
+            stagedAt = millis();
+        }
+        if (hour % 24 == 18)
+        {
+            ec = 320; //nutrient top up, an abrupt change
+        }
+        if (hour % 24 == 6)
+        {
+            ec = 300; //consumed again
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (unsigned long i = 0; i < iterationsPerHour; i++)
+        {
+            hostClockAdvance(SOAK_STEP * 1000UL);
+            unsigned long now = millis();
+
+            bool due = meter.isSampleDue();
+            CHECK(due == ((long)(int32_t)(now - meter.nextSampleDue()) >= 0));
+            if (due)
+            {
+                meter.readEC(ec + noise() * 0.2, 25 + noise());
+                meter.readPH(ph + noise() * 0.2, 25 + noise());
+                CHECK(meter.sampleInterval() >= SAMPLE_INTERVAL_MIN && meter.sampleInterval() <= SAMPLE_INTERVAL_MAX);
+                longestInterval = std::max(longestInterval, meter.sampleInterval());
+                samples++;
+            }
+
+            meter.update();
+            meter.idle();
+            if (staged)
+            {
+                //the staged calibration is committed on the first idle() after the delay, not before
+                bool expired = (uint32_t)(now - stagedAt) >= ECPH_COMMIT_DELAY;
+                CHECK(EEPROM.commits == commits + (expired ? 1 : 0));
+                if (expired)
+                {
+                    staged = false;
+                    commits = EEPROM.commits;
+                }
+            }
+            CHECK(!staged || meter.isCommitPending());
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        hourCost.push_back(ns / iterationsPerHour);
+        if (hourCost.size() == 24)
+        {
+            std::sort(hourCost.begin(), hourCost.end());
+            dayMedian.push_back(hourCost[12]);
+            printf("day %2lu  millis %10lu  loop %.0f ns median, %.0f ns worst hour\n",
+                   (unsigned long)dayMedian.size(), millis(), hourCost[12], hourCost[23]);
+            hourCost.clear();
+        }
+    }
+
+    CHECK(samples > 0);
+    CHECK(longestInterval > SAMPLE_INTERVAL_MIN); //the governor backed off while stable
+    CHECK(EEPROM.commits == SOAK_DAYS);            //one commit per daily calibration
+    CHECK(dayMedian.back() <= dayMedian.front() * SOAK_COST_GROWTH + 100.0);
+}
+
+int main()
+{
+    testCommandTimeoutAcrossWrap();
+    testDeadlinesAcrossWrap();
+    testSoak();
+    return TEST_RESULT();
+}
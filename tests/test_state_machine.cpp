@@ -0,0 +1,149 @@
+/*
+ * file tests/test_state_machine.cpp
+ *
+ * Calibration state machine: every (state, command) cell of the transition
+ * table against an expected table written out here, on a blank and on a
+ * calibrated EEPROM. Checks the next state, the failed flag, the legacy
+ * calmode and isCalibrated() after each command.
+ */
+
+#include "DFRobot_ESP_EC_PH.h"
+#include "DFRobot_ESP_EC_PH_Stream.h"
+#include "EEPROM.h"
+#include "ecph_test.h"
+#include "ecph_test_access.h"
+
+#define STATES 4    //idle, EC session, pH session, pump setup
+#define COMMANDS 13 //command codes of cmdParse(), 9..12 are internal
+#define EC_BUFFER_1413 232 //mV of the 1.413 ms/cm buffer with K = 1
+#define PUMP_TIME "1500\n"
+
+static const char *stateNames[STATES] = {"idle", "EC", "pH", "pump"};
+static const char *commandNames[COMMANDS] = {"unknown", "ENTEREC", "CALEC", "EXITEC", "ENTERPH", "CALPH", "EXITPH",
+                                              "ECPHDOWN", "ECPHUP", "-", "pump on", "pump off", "pump exit"};
+static const int stateMode[STATES] = {0, 1, 2, 4};
+
+struct Expected
+{
+    byte next;
+    bool failed;
+};
+
+//I idle, E EC, P pH, U pump; lower case when the command fails
+static const char *expectedTable[STATES] = {
+    //unk ENTEREC CALEC EXITEC ENTERPH CALPH EXITPH DOWN UP - on off exit
+    "I"  "E"     "i"   "i"    "P"     "i"   "i"    "I"  "I" "I" "U" "U" "i", //idle
+    "i"  "E"     "E"   "i"    "i"     "i"   "i"    "E"  "E" "E" "i" "i" "i", //EC session, EXITEC fails without a calibrated point
+    "i"  "i"     "i"   "i"    "P"     "P"   "i"    "P"  "P" "P" "i" "i" "i", //pH session, ENTEREC resets to idle
+    "U"  "i"     "i"   "i"    "i"     "i"   "i"    "U"  "U" "U" "U" "U" "i", //pump setup, exit fails with only the on time set
+};
+
+static Expected expected(int state, int command)
+{
+    char cell = expectedTable[state][command];
+    Expected e;
+    e.failed = (cell >= 'a');
+    switch (cell | 0x20)
+    {
+    case 'e': e.next = 1; break;
+    case 'p': e.next = 2; break;
+    case 'u': e.next = 3; break;
+    default: e.next = 0; break;
+    }
+    return e;
+}
+
+static void enterState(DFRobot_ESP_EC_PH &meter, int state)
+{
+    //readings the CAL commands use: the 1.413 ms/cm and the pH 7.0 buffer
+    meter.readEC(EC_BUFFER_1413, 25);
+    meter.ECcalibration(EC_BUFFER_1413, 25);
+    meter.PHcalibration(PH_7_AT_25, 25);
+    switch (state)
+    {
+    case 1: ECPHTestAccess::calibration(meter, 1); break;
+    case 2: ECPHTestAccess::calibration(meter, 4); break;
+    case 3:
+        Serial.feed(PUMP_TIME);
+        ECPHTestAccess::calibration(meter, 10);
+        break;
+    }
+    CHECK(ECPHTestAccess::calState(meter) == state);
+}
+
+static void runTable(const uint8_t *image, int calibrated)
+{
+    for (int state = 0; state < STATES; state++)
+    {
+        for (int command = 0; command < COMMANDS; command++)
+        {
+            memcpy(EEPROM.flash, image, sizeof(EEPROM.flash));
+            EEPROM.reboot();
+            DFRobot_ESP_EC_PH meter;
+            meter.begin();
+            enterState(meter, state);
+
+            Serial.clear();
+            if (command == 10 || command == 11)
+            {
+                Serial.feed(PUMP_TIME); //the value line of the prompt
+            }
+            ECPHTestAccess::calibration(meter, command);
+            Expected e = expected(state, command);
+            byte next = ECPHTestAccess::calState(meter);
+            bool failed = ECPHTestAccess::cmdFailed(meter);
+            if (next != e.next || failed != e.failed || meter.getCalibrationMode() != stateMode[e.next] ||
+                meter.isCalibrated() != calibrated)
+            {
+                fprintf(stderr, "%s + %s: state %d failed %d calmode %d calibrated %d\n", stateNames[state],
+                        commandNames[command], next, failed, meter.getCalibrationMode(), meter.isCalibrated());
+            }
+            CHECK(next == e.next);
+            CHECK(failed == e.failed);
+            CHECK(meter.getCalibrationMode() == stateMode[e.next]);
+            CHECK(meter.isCalibrated() == calibrated);
+        }
+    }
+    Serial.clear();
+}
+
+//a CALEC on a reading that matches no buffer keeps the session open and computes no K value
+static void testBufferError()
+{
+    EEPROM.erase();
+    DFRobot_ESP_EC_PH meter;
+    meter.begin();
+    float before = meter.readEC(1000, 25);
+    ECPHTestAccess::calibration(meter, 1);
+    meter.readEC(5, 25);
+    meter.ECcalibration(5, 25);
+    ECPHTestAccess::calibration(meter, 2);
+    CHECK(ECPHTestAccess::cmdFailed(meter));
+    CHECK(ECPHTestAccess::calState(meter) == 1);
+    ECPHTestAccess::calibration(meter, 3);
+    CHECK(ECPHTestAccess::cmdFailed(meter)); //nothing to save
+    CHECK(!meter.isCommitPending());
+    CHECK(meter.readEC(1000, 25) == before);
+}
+
+int main()
+{
+    hostClockSetMillis(1000);
+    EEPROM.erase();
+    uint8_t blank[sizeof(EEPROM.flash)];
+    memcpy(blank, EEPROM.flash, sizeof(blank));
+    runTable(blank, 3);
+
+    //both probes calibrated before the reboot, no single command takes that away
+    ECPHBufferStream console;
+    DFRobot_ESP_EC_PH meter;
+    meter.begin();
+    CHECK(meter.runBatch("ENTEREC;CALEC=232@25;CALEC=2112@25;EXITEC", console));
+    CHECK(meter.runBatch("ENTERPH;CALPH=1130@25;CALPH=1525@25;EXITPH", console));
+    uint8_t calibrated[sizeof(EEPROM.flash)];
+    memcpy(calibrated, EEPROM.flash, sizeof(calibrated));
+    runTable(calibrated, 0);
+
+    testBufferError();
+    return TEST_RESULT();
+}
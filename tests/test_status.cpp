@@ -0,0 +1,75 @@
+/*
+ * file tests/test_status.cpp
+ *
+ * Status snapshot: the JSON numbers are written without printf, fixed point
+ * with STATUS_JSON_DECIMALS, null when out of range.
+ */
+
+#include "DFRobot_ESP_EC_PH.h"
+#include "ecph_test.h"
+#include <stdlib.h>
+#include <string.h>
+
+static bool jsonNumber(const char *json, const char *key, double &value)
+{
+    char pattern[32];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char *at = strstr(json, pattern);
+    if (at == NULL)
+    {
+        return false;
+    }
+    at += strlen(pattern);
+    if (strncmp(at, "null", 4) == 0)
+    {
+        value = NAN;
+        return true;
+    }
+    char *end;
+    value = strtod(at, &end);
+    return end != at && (*end == ',' || *end == '}');
+}
+
+static void checkValue(float ecVoltage, float temperature)
+{
+    DFRobot_ESP_EC_PH meter;
+    meter.begin();
+    meter.ECcalibration(ecVoltage, temperature); //stores both for the snapshot
+    char json[STATUS_JSON_MAX_LENGTH];
+    CHECK(meter.statusJSON(json, sizeof(json)) > 0);
+    double voltage, temp;
+    CHECK(jsonNumber(json, "ecVoltage", voltage));
+    CHECK(jsonNumber(json, "temperature", temp));
+    if (isnan(ecVoltage) || fabsf(ecVoltage) >= STATUS_JSON_FLOAT_LIMIT)
+    {
+        CHECK(isnan(voltage));
+    }
+    else
+    {
+        CHECK_NEAR(voltage, ecVoltage, 0.5 / STATUS_JSON_SCALE + fabsf(ecVoltage) * 1e-7);
+    }
+    CHECK_NEAR(temp, temperature, 0.5 / STATUS_JSON_SCALE + fabsf(temperature) * 1e-7);
+}
+
+int main()
+{
+    hostClockSetMillis(1000);
+    checkValue(1134.5f, 25.0f);
+    checkValue(0.00004f, -127.0f);  //rounds to 0, no "-0"
+    checkValue(3299.9999f, -0.25f);
+    checkValue(-12.0625f, 0.0005f);
+    checkValue(399999.0f, 59.9f);
+    checkValue(400000.0f, 1.0f);
+    checkValue(NAN, 7.0f);
+
+    DFRobot_ESP_EC_PH meter;
+    meter.begin();
+    meter.ECcalibration(-0.00001f, 25);
+    char json[STATUS_JSON_MAX_LENGTH];
+    meter.statusJSON(json, sizeof(json));
+    CHECK(strstr(json, "\"ecVoltage\":0,") != NULL);
+    CHECK(strstr(json, "\"temperature\":25,") != NULL);
+    CHECK(strstr(json, "\"calmode\":0,") != NULL);
+    printf("%s\n", json);
+    return TEST_RESULT();
+}
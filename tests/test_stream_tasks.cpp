@@ -0,0 +1,81 @@
+/*
+ * file tests/test_stream_tasks.cpp
+ *
+ * ESP32 build (ecph_esp32, FreeRTOS stand-in): ECPHBufferStream with one
+ * thread feeding and draining while another reads and writes, every byte
+ * arrives once and in order in both directions. A lost update needs two
+ * cores to show up reliably, -fsanitize=thread catches the race anywhere.
+ */
+
+#include "DFRobot_ESP_EC_PH_Stream.h"
+#include "ecph_test.h"
+#include <thread>
+
+#define STREAM_TASK_BYTES 200000UL
+
+static void gateway(ECPHBufferStream *port, unsigned long *replyErrors)
+{
+    unsigned long fed = 0, drained = 0;
+    while (fed < STREAM_TASK_BYTES || drained < STREAM_TASK_BYTES)
+    {
+        uint8_t data = (uint8_t)fed;
+        bool moved = false;
+        if (fed < STREAM_TASK_BYTES && port->feed(&data, 1) == 1)
+        {
+            fed++;
+            moved = true;
+        }
+        char reply[16];
+        size_t n = port->drain(reply, sizeof(reply));
+        for (size_t i = 0; i < n; i++, drained++)
+        {
+            if ((uint8_t)reply[i] != (uint8_t)(drained * 3))
+            {
+                (*replyErrors)++;
+            }
+        }
+        if (!moved && n == 0)
+        {
+            std::this_thread::yield(); //let the other side run on a single core host
+        }
+    }
+}
+
+int main()
+{
+    ECPHBufferStream port;
+    unsigned long replyErrors = 0, commandErrors = 0;
+    std::thread feeder(gateway, &port, &replyErrors);
+
+    unsigned long received = 0, sent = 0;
+    while (received < STREAM_TASK_BYTES || sent < STREAM_TASK_BYTES)
+    {
+        int data = port.read();
+        bool moved = data >= 0;
+        if (data >= 0)
+        {
+            if (data != (uint8_t)received)
+            {
+                commandErrors++;
+            }
+            received++;
+        }
+        //replies only while the gateway keeps up, write() drops the oldest byte when full
+        if (sent < STREAM_TASK_BYTES && port.pending() < ECPH_BUFFER_STREAM_LENGTH)
+        {
+            port.write((uint8_t)(sent++ * 3));
+            moved = true;
+        }
+        if (!moved)
+        {
+            std::this_thread::yield();
+        }
+    }
+    feeder.join();
+
+    CHECK(commandErrors == 0);
+    CHECK(replyErrors == 0);
+    CHECK(port.available() == 0);
+    CHECK(port.pending() == 0);
+    return TEST_RESULT();
+}
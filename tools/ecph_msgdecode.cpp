@@ -0,0 +1,79 @@
+/*
+ * file ecph_msgdecode.cpp
+ *
+ * Host side decoder for logs captured from firmware built with ECPH_MESSAGE_CODES.
+ * Expands every "#<code>" token back to the catalog text of DFRobot_ESP_EC_PH_Messages.h
+ *
+ * build:  the ecph_msgdecode target of the top level CMakeLists.txt
+ * usage:  ecph_msgdecode < serial.log      decode a log from stdin
+ *         ecph_msgdecode --list            print the catalog
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include "DFRobot_ESP_EC_PH_Messages.h"
+
+static const char *const messageText[ECPH_MESSAGE_COUNT] = {
+#define ECPH_MESSAGE_TEXT(id, text) text,
+    ECPH_MESSAGE_LIST(ECPH_MESSAGE_TEXT)
+#undef ECPH_MESSAGE_TEXT
+};
+
+static const char *const messageName[ECPH_MESSAGE_COUNT] = {
+#define ECPH_MESSAGE_NAME(id, text) #id,
+    ECPH_MESSAGE_LIST(ECPH_MESSAGE_NAME)
+#undef ECPH_MESSAGE_NAME
+};
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--list") == 0)
+    {
+        for (int i = 0; i < ECPH_MESSAGE_COUNT; i++)
+        {
+            printf("#%d\t%s\t%s\n", i, messageName[i], messageText[i]);
+        }
+        return 0;
+    }
+
+    int c = getchar();
+    while (c != EOF)
+    {
+        if (c != '#')
+        {
+            putchar(c);
+            c = getchar();
+            continue;
+        }
+        //"#<code>" optionally followed by the single separator space printed by printMessage()
+        char digits[8];
+        int n = 0;
+        c = getchar();
+        while (c != EOF && isdigit(c) && n < (int)sizeof(digits) - 1)
+        {
+            digits[n++] = (char)c;
+            c = getchar();
+        }
+        digits[n] = '\0';
+        int code = -1;
+        if (n > 0)
+        {
+            sscanf(digits, "%d", &code);
+        }
+        if (code >= 0 && code < ECPH_MESSAGE_COUNT)
+        {
+            fputs(messageText[code], stdout);
+            if (c == ' ')
+            {
+                c = getchar();
+            }
+        }
+        else
+        {
+            putchar('#'); //not a catalog code, pass through untouched
+            fputs(digits, stdout);
+        }
+    }
+    return 0;
+}
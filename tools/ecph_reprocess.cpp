@@ -0,0 +1,318 @@
+/*
+ * file ecph_reprocess.cpp
+ *
+ * Host side reprocessing of logged probe voltages with new calibration values.
+ * Converts with the same code as readEC() / readPH() (DFRobot_ESP_EC_PH_Core.h),
+ * spread over all cores. The EC auto range carries state from one record to the
+ * next, so every chunk first works out its exit range for both entry ranges, the
+ * chunks are chained in order, then converted: the output is identical to a
+ * single threaded run.
+ *
+ * input, one record per line (lines not starting with a digit are skipped):
+ *     timestamp,ec_mV,ph_mV,temperature
+ * or with --format bin, 16 byte host order records:
+ *     uint32 timestamp, float ec_mV, float ph_mV, float temperature
+ * output CSV: timestamp,ec,ph,range  (range 1 = kvalueLow, 2 = kvalueHigh)
+ *
+ * build:  the ecph_reprocess target of the top level CMakeLists.txt
+ * usage:  ecph_reprocess [options] log.csv > converted.csv
+ *     --klow K --khigh K          EC K values (default 1.0)
+ *     --neutral mV --acid mV      pH buffer voltages (default PH_7_AT_25, PH_4_AT_25)
+ *     --caltemp C                 pH buffer temperature (default 25)
+ *     --threads N                 worker threads (default all cores)
+ *     --format csv|bin            input format (default from the .bin extension)
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "DFRobot_ESP_EC_PH_Core.h"
+
+#define BIN_RECORD_LENGTH 16
+#define LINE_MAX_LENGTH 128
+
+struct Record
+{
+    uint32_t timestamp;
+    float ecVoltage;
+    float phVoltage;
+    float temperature;
+};
+
+struct Settings
+{
+    float kvalueLow;
+    float kvalueHigh;
+    float phSlope;
+    float neutralVoltage;
+};
+
+struct Chunk
+{
+    const char *begin;
+    const char *end;
+    std::vector<Record> records;
+    bool exitRange[2]; // range after the last record, indexed by the entry range
+    bool entryRange;
+    std::string output;
+};
+
+static bool parseLine(const char *line, size_t length, Record &record)
+{
+    char buffer[LINE_MAX_LENGTH];
+    if (length == 0 || length >= sizeof(buffer) || line[0] < '0' || line[0] > '9')
+    {
+        return false;
+    }
+    memcpy(buffer, line, length);
+    buffer[length] = '\0';
+    char *field = buffer;
+    char *next;
+    record.timestamp = strtoul(field, &next, 10);
+    if (*next != ',')
+        return false;
+    field = next + 1;
+    record.ecVoltage = strtof(field, &next);
+    if (next == field || *next != ',')
+        return false;
+    field = next + 1;
+    record.phVoltage = strtof(field, &next);
+    if (next == field || *next != ',')
+        return false;
+    field = next + 1;
+    record.temperature = strtof(field, &next);
+    if (next == field)
+        return false; //temperature missing
+    while (*next == ' ' || *next == '\t')
+        next++;
+    return *next == '\0'; //only whitespace after the last field
+}
+
+static void parseChunk(Chunk &chunk, bool binary)
+{
+    if (binary)
+    {
+        for (const char *p = chunk.begin; p + BIN_RECORD_LENGTH <= chunk.end; p += BIN_RECORD_LENGTH)
+        {
+            Record record;
+            memcpy(&record.timestamp, p, 4);
+            memcpy(&record.ecVoltage, p + 4, 4);
+            memcpy(&record.phVoltage, p + 8, 4);
+            memcpy(&record.temperature, p + 12, 4);
+            chunk.records.push_back(record);
+        }
+        return;
+    }
+    const char *p = chunk.begin;
+    while (p < chunk.end)
+    {
+        const char *eol = (const char *)memchr(p, '\n', chunk.end - p);
+        if (eol == NULL)
+            eol = chunk.end;
+        size_t length = eol - p;
+        if (length > 0 && p[length - 1] == '\r')
+            length--;
+        Record record;
+        if (parseLine(p, length, record))
+        {
+            chunk.records.push_back(record);
+        }
+        p = eol + 1;
+    }
+}
+
+//pass 1: parse, and follow the range for both possible entry ranges
+static void scanChunk(Chunk *chunk, bool binary, const Settings *settings)
+{
+    parseChunk(*chunk, binary);
+    for (int entry = 0; entry < 2; entry++)
+    {
+        bool rangeHigh = entry != 0;
+        for (size_t i = 0; i < chunk->records.size(); i++)
+        {
+            rangeHigh = ecphRangeHigh(ecphRawEC(chunk->records[i].ecVoltage), rangeHigh, settings->kvalueLow, settings->kvalueHigh);
+        }
+        chunk->exitRange[entry] = rangeHigh;
+    }
+}
+
+//pass 2: convert from the known entry range
+static void convertChunk(Chunk *chunk, const Settings *settings)
+{
+    char line[LINE_MAX_LENGTH];
+    bool rangeHigh = chunk->entryRange;
+    chunk->output.reserve(chunk->records.size() * 32);
+    for (size_t i = 0; i < chunk->records.size(); i++)
+    {
+        const Record &record = chunk->records[i];
+        float rawEC = ecphRawEC(record.ecVoltage);
+        rangeHigh = ecphRangeHigh(rawEC, rangeHigh, settings->kvalueLow, settings->kvalueHigh);
+        float ec = ecphEC(rawEC, rangeHigh ? settings->kvalueHigh : settings->kvalueLow, record.temperature);
+        float ph = ecphPH(record.phVoltage, record.temperature, settings->phSlope, settings->neutralVoltage);
+        int length = snprintf(line, sizeof(line), "%lu,%.4f,%.3f,%d\n", (unsigned long)record.timestamp, ec, ph, rangeHigh ? 2 : 1);
+        chunk->output.append(line, length);
+    }
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: ecph_reprocess [--klow K] [--khigh K] [--neutral mV] [--acid mV] [--caltemp C]\n"
+                    "                      [--threads N] [--format csv|bin] log\n");
+}
+
+int main(int argc, char **argv)
+{
+    float kvalueLow = 1.0;
+    float kvalueHigh = 1.0;
+    float neutralVoltage = PH_7_AT_25;
+    float acidVoltage = PH_4_AT_25;
+    float calTemperature = 25.0;
+    unsigned threads = std::thread::hardware_concurrency();
+    int binary = -1;
+    const char *path = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (arg[0] != '-')
+        {
+            path = arg;
+            continue;
+        }
+        if (value == NULL)
+        {
+            usage();
+            return 2;
+        }
+        i++;
+        if (strcmp(arg, "--klow") == 0)
+            kvalueLow = atof(value);
+        else if (strcmp(arg, "--khigh") == 0)
+            kvalueHigh = atof(value);
+        else if (strcmp(arg, "--neutral") == 0)
+            neutralVoltage = atof(value);
+        else if (strcmp(arg, "--acid") == 0)
+            acidVoltage = atof(value);
+        else if (strcmp(arg, "--caltemp") == 0)
+            calTemperature = atof(value);
+        else if (strcmp(arg, "--threads") == 0)
+            threads = atoi(value);
+        else if (strcmp(arg, "--format") == 0)
+            binary = strcmp(value, "bin") == 0;
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+    if (path == NULL || neutralVoltage == acidVoltage)
+    {
+        usage();
+        return 2;
+    }
+    if (binary < 0)
+    {
+        size_t length = strlen(path);
+        binary = length > 4 && strcmp(path + length - 4, ".bin") == 0;
+    }
+    if (threads == 0)
+        threads = 1;
+
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        perror(path);
+        return 1;
+    }
+    size_t size = st.st_size;
+    const char *data = NULL;
+    if (size > 0)
+    {
+        data = (const char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            perror(path);
+            return 1;
+        }
+        madvise((void *)data, size, MADV_SEQUENTIAL);
+    }
+
+    Settings settings;
+    settings.kvalueLow = kvalueLow;
+    settings.kvalueHigh = kvalueHigh;
+    settings.phSlope = ecphPHSlope(neutralVoltage, acidVoltage, calTemperature);
+    settings.neutralVoltage = neutralVoltage;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    //chunk boundaries on record boundaries: after a newline, or a multiple of the record length
+    std::vector<Chunk> chunks(threads);
+    const char *end = data + size;
+    const char *p = data;
+    for (unsigned i = 0; i < threads; i++)
+    {
+        const char *split = i + 1 == threads ? end : data + size / threads * (i + 1);
+        if (binary)
+        {
+            split = data + (split - data) / BIN_RECORD_LENGTH * BIN_RECORD_LENGTH;
+        }
+        else if (split < end)
+        {
+            const char *eol = (const char *)memchr(split, '\n', end - split);
+            split = eol == NULL ? end : eol + 1;
+        }
+        if (split < p)
+            split = p;
+        chunks[i].begin = p;
+        chunks[i].end = split;
+        p = split;
+    }
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < threads; i++)
+        workers.push_back(std::thread(scanChunk, &chunks[i], binary != 0, &settings));
+    for (unsigned i = 0; i < threads; i++)
+        workers[i].join();
+    workers.clear();
+
+    //chain the ranges in log order, the first record starts low like after begin()
+    bool rangeHigh = false;
+    for (unsigned i = 0; i < threads; i++)
+    {
+        chunks[i].entryRange = rangeHigh;
+        rangeHigh = chunks[i].exitRange[rangeHigh ? 1 : 0];
+    }
+
+    for (unsigned i = 0; i < threads; i++)
+        workers.push_back(std::thread(convertChunk, &chunks[i], &settings));
+    for (unsigned i = 0; i < threads; i++)
+        workers[i].join();
+
+    size_t records = 0;
+    for (unsigned i = 0; i < threads; i++)
+    {
+        fwrite(chunks[i].output.data(), 1, chunks[i].output.size(), stdout);
+        records += chunks[i].records.size();
+    }
+    fflush(stdout);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "%lu records, %u threads, %.3f s, %.0f records/s\n",
+            (unsigned long)records, threads, seconds, seconds > 0 ? records / seconds : 0.0);
+
+    if (data != NULL)
+        munmap((void *)data, size);
+    close(fd);
+    return 0;
+}